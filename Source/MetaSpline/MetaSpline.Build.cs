@@ -19,6 +19,7 @@ public class MetaSpline : ModuleRules
 			{
 				"CoreUObject",
 				"Engine",
+				"RenderCore",
 				"Slate",
 				"SlateCore",
 				"DeveloperSettings",
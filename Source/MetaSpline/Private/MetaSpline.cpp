@@ -1,6 +1,7 @@
 // Copyright(c) 2021 Viktor Pramberg
 #include "MetaSpline.h"
 #include "MetaSplineDebugRenderer.h"
+#include "MetaSplineConstructionQueue.h"
 
 DEFINE_LOG_CATEGORY(LogMetaSpline);
 
@@ -9,6 +10,10 @@ void FMetaSplineModule::StartupModule()
 #if !UE_BUILD_SHIPPING
 	DebugRenderer.Reset(new FMetaSplineDebugRenderer());
 #endif
+
+#if WITH_EDITOR
+	ConstructionQueue.Reset(new FMetaSplineConstructionQueue());
+#endif
 }
 
 void FMetaSplineModule::ShutdownModule()
@@ -16,6 +21,10 @@ void FMetaSplineModule::ShutdownModule()
 #if !UE_BUILD_SHIPPING
 	DebugRenderer.Reset();
 #endif
+
+#if WITH_EDITOR
+	ConstructionQueue.Reset();
+#endif
 }
 
 IMPLEMENT_MODULE(FMetaSplineModule, MetaSpline)
\ No newline at end of file
@@ -1,23 +1,63 @@
 // Copyright(c) 2021 Viktor Pramberg
 #include "MetaSplineComponent.h"
+#include "MetaSplineEvaluation.h"
+#include "MetaSplineSettings.h"
+#include "MetaSplinePropertyLayout.h"
+#include "MetaSplineSubsystem.h"
+#include "MetaSplineSnapshot.h"
+#include "MetaSplinePointChange.h"
+#include "MetaSpline.h"
+
+#include "Engine/Engine.h"
 
 FProperty* UMetaSplineComponent::MetadataProperty = FindFProperty<FProperty>(UMetaSplineComponent::StaticClass(), GET_MEMBER_NAME_CHECKED(UMetaSplineComponent, Metadata));
 FProperty* UMetaSplineComponent::ClosedLoopProperty = FindFProperty<FProperty>(USplineComponent::StaticClass(), FName(TEXT("bClosedLoop")));
 FProperty* UMetaSplineComponent::LoopPositionOverrideProperty = FindFProperty<FProperty>(USplineComponent::StaticClass(), FName(TEXT("bLoopPositionOverride")));
 FProperty* UMetaSplineComponent::LoopPositionProperty = FindFProperty<FProperty>(USplineComponent::StaticClass(), FName(TEXT("LoopPosition")));
 
+namespace MetaSplineComponent_Private
+{
+	// Compares the points of two curves, ignoring the tangents and input keys UpdateSpline() derives from them.
+	template<typename T>
+	bool HasSamePoints(const FInterpCurve<T>& A, const FInterpCurve<T>& B)
+	{
+		if (A.Points.Num() != B.Points.Num() || A.bIsLooped != B.bIsLooped)
+		{
+			return false;
+		}
+
+		for (int32 i = 0; i < A.Points.Num(); i++)
+		{
+			const FInterpCurvePoint<T>& PointA = A.Points[i];
+			const FInterpCurvePoint<T>& PointB = B.Points[i];
+			const bool bUserTangents = PointA.InterpMode == CIM_CurveUser || PointA.InterpMode == CIM_CurveBreak;
+			if (PointA.OutVal != PointB.OutVal || PointA.InterpMode != PointB.InterpMode ||
+				(bUserTangents && (PointA.ArriveTangent != PointB.ArriveTangent || PointA.LeaveTangent != PointB.LeaveTangent)))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool HasSamePoints(const FSplineCurves& A, const FSplineCurves& B)
+	{
+		return HasSamePoints(A.Position, B.Position) && HasSamePoints(A.Rotation, B.Rotation) && HasSamePoints(A.Scale, B.Scale);
+	}
+}
+
 UMetaSplineComponent::UMetaSplineComponent()
 {
 	Metadata = CreateDefaultSubobject<UMetaSplineMetadata>(TEXT("Metadata"));
 }
 
 // -- New metadata accessors --
-template<class T>
-T GetPropertyValueAtKey(const UMetaSplineMetadata* Metadata, float InKey, FName PropertyName)
+template<class T, class TProperty>
+T GetPropertyValueAtKey(const UMetaSplineMetadata* Metadata, float InKey, const TProperty& Property)
 {
 	if (Metadata)
 	{
-		if (auto* Curve = Metadata->FindCurve<T>(PropertyName))
+		if (const auto Curve = Metadata->FindCurve<T>(Property))
 		{ 
 			return Curve->Eval(InKey);
 		}
@@ -45,6 +85,415 @@ FVector UMetaSplineComponent::GetMetadataVectorAtKey(FName InProperty, float InK
 	return GetPropertyValueAtKey<FVector>(Metadata, InKey, InProperty);
 }
 
+FRotator UMetaSplineComponent::GetMetadataRotatorAtPoint(FName InProperty, int32 InIndex) const
+{
+	return GetMetadataRotatorAtKey(InProperty, static_cast<float>(InIndex));
+}
+
+FRotator UMetaSplineComponent::GetMetadataRotatorAtKey(FName InProperty, float InKey) const
+{
+	return GetMetadataAtKey<FQuat>(InProperty, InKey).Rotator();
+}
+
+FLinearColor UMetaSplineComponent::GetMetadataColorAtPoint(FName InProperty, int32 InIndex) const
+{
+	return GetMetadataColorAtKey(InProperty, static_cast<float>(InIndex));
+}
+
+FLinearColor UMetaSplineComponent::GetMetadataColorAtKey(FName InProperty, float InKey) const
+{
+	return GetMetadataAtKey<FLinearColor>(InProperty, InKey);
+}
+
+FVector2D UMetaSplineComponent::GetMetadataVector2DAtPoint(FName InProperty, int32 InIndex) const
+{
+	return GetMetadataVector2DAtKey(InProperty, static_cast<float>(InIndex));
+}
+
+FVector2D UMetaSplineComponent::GetMetadataVector2DAtKey(FName InProperty, float InKey) const
+{
+	return GetMetadataAtKey<FVector2D>(InProperty, InKey);
+}
+
+// -- Handle based metadata accessors --
+FMetaSplinePropertyHandle UMetaSplineComponent::ResolveMetadataProperty(FName InProperty) const
+{
+	return UMetaSplineMetadata::MakePropertyHandle(MetadataClass.Get(), InProperty);
+}
+
+FMetaSplinePropertyHandle UMetaSplineComponent::MakeMetadataPropertyHandle(TSubclassOf<UObject> InMetaClass, FName InProperty)
+{
+	return UMetaSplineMetadata::MakePropertyHandle(InMetaClass.Get(), InProperty);
+}
+
+float UMetaSplineComponent::GetMetadataFloatAtPoint(const FMetaSplinePropertyHandle& InHandle, int32 InIndex) const
+{
+	return GetMetadataFloatAtKey(InHandle, static_cast<float>(InIndex));
+}
+
+FVector UMetaSplineComponent::GetMetadataVectorAtPoint(const FMetaSplinePropertyHandle& InHandle, int32 InIndex) const
+{
+	return GetMetadataVectorAtKey(InHandle, static_cast<float>(InIndex));
+}
+
+float UMetaSplineComponent::GetMetadataFloatAtKey(const FMetaSplinePropertyHandle& InHandle, float InKey) const
+{
+	return GetPropertyValueAtKey<float>(Metadata, InKey, InHandle);
+}
+
+FVector UMetaSplineComponent::GetMetadataVectorAtKey(const FMetaSplinePropertyHandle& InHandle, float InKey) const
+{
+	return GetPropertyValueAtKey<FVector>(Metadata, InKey, InHandle);
+}
+
+float UMetaSplineComponent::GetMetadataFloatAtPointWithHandle(const FMetaSplinePropertyHandle& InHandle, int32 InIndex) const
+{
+	return GetMetadataFloatAtPoint(InHandle, InIndex);
+}
+
+FVector UMetaSplineComponent::GetMetadataVectorAtPointWithHandle(const FMetaSplinePropertyHandle& InHandle, int32 InIndex) const
+{
+	return GetMetadataVectorAtPoint(InHandle, InIndex);
+}
+
+float UMetaSplineComponent::GetMetadataFloatAtKeyWithHandle(const FMetaSplinePropertyHandle& InHandle, float InKey) const
+{
+	return GetMetadataFloatAtKey(InHandle, InKey);
+}
+
+FVector UMetaSplineComponent::GetMetadataVectorAtKeyWithHandle(const FMetaSplinePropertyHandle& InHandle, float InKey) const
+{
+	return GetMetadataVectorAtKey(InHandle, InKey);
+}
+
+// -- Batched metadata accessors --
+template<class T>
+void EvaluatePropertyBatch(const UMetaSplineMetadata* Metadata, const FMetaSplinePropertyHandle& InHandle, TArrayView<const float> InKeys, TArrayView<T> OutValues)
+{
+	if (Metadata)
+	{
+		FMetaSplineEvaluation::EvaluateBatch(Metadata->FindCurve<T>(InHandle), InKeys, OutValues);
+	}
+	else
+	{
+		FMetaSplineEvaluation::EvaluateBatch(TMetaSplineCurveView<const T>(), InKeys, OutValues);
+	}
+}
+
+void UMetaSplineComponent::EvaluateMetadataBatch(const FMetaSplinePropertyHandle& InHandle, TArrayView<const float> InKeys, TArrayView<float> OutValues) const
+{
+	EvaluatePropertyBatch<float>(Metadata, InHandle, InKeys, OutValues);
+}
+
+void UMetaSplineComponent::EvaluateMetadataBatch(const FMetaSplinePropertyHandle& InHandle, TArrayView<const float> InKeys, TArrayView<FVector> OutValues) const
+{
+	EvaluatePropertyBatch<FVector>(Metadata, InHandle, InKeys, OutValues);
+}
+
+TArray<float> UMetaSplineComponent::GetMetadataFloatAtKeys(const FMetaSplinePropertyHandle& InHandle, const TArray<float>& InKeys) const
+{
+	TArray<float> Values;
+	Values.SetNumUninitialized(InKeys.Num());
+	EvaluateMetadataBatch(InHandle, InKeys, Values);
+	return Values;
+}
+
+TArray<FVector> UMetaSplineComponent::GetMetadataVectorAtKeys(const FMetaSplinePropertyHandle& InHandle, const TArray<float>& InKeys) const
+{
+	TArray<FVector> Values;
+	Values.SetNumUninitialized(InKeys.Num());
+	EvaluateMetadataBatch(InHandle, InKeys, Values);
+	return Values;
+}
+
+// -- Metadata writers --
+template<typename T, typename FGetPoint>
+int32 UMetaSplineComponent::SetMetadataAtPoints(FName InProperty, int32 InNum, FGetPoint&& GetPoint)
+{
+	if (!Metadata)
+	{
+		return 0;
+	}
+
+	// Find the points that change before touching anything, so that writing the current values doesn't copy shared storage,
+	// record a transaction or recompute tangents.
+	const auto CurrentCurve = AsConst(*Metadata).FindCurve<T>(InProperty);
+	if (!CurrentCurve)
+	{
+		UE_LOG(LogMetaSpline, Warning, TEXT("%s has no metadata property %s of the requested type."), *GetPathName(), *InProperty.ToString());
+		return 0;
+	}
+
+	TArray<TPair<int32, T>> ChangedPoints;
+	int32 DirtyBegin = MAX_int32;
+	int32 DirtyEnd = 0;
+	for (int32 i = 0; i < InNum; i++)
+	{
+		const TPair<int32, T> Point = GetPoint(i);
+		if (Point.Key >= 0 && Point.Key < CurrentCurve.Num() && CurrentCurve.GetValue(Point.Key) != Point.Value)
+		{
+			ChangedPoints.Add(Point);
+			DirtyBegin = FMath::Min(DirtyBegin, Point.Key);
+			DirtyEnd = FMath::Max(DirtyEnd, Point.Key + 1);
+		}
+	}
+
+	if (ChangedPoints.Num() == 0)
+	{
+		return 0;
+	}
+
+#if WITH_EDITOR
+	const UWorld* World = GetWorld();
+	const bool bTransact = GEngine && !(World && World->IsGameWorld());
+	if (bTransact)
+	{
+		Metadata->SetFlags(RF_Transactional);
+		GEngine->BeginTransaction(TEXT("MetaSpline"), NSLOCTEXT("MetaSplineComponent", "SetMetadata", "MetaSpline: Set metadata"), Metadata);
+	}
+#endif
+
+	// Only the written values are recorded for undo, instead of a snapshot of every curve like Modify() would record.
+	if (Metadata->IsRecordingPointChanges())
+	{
+		TArray<int32> Indices;
+		FMetaSplinePointValues Before;
+		FMetaSplinePointValues After;
+		Indices.Reserve(ChangedPoints.Num());
+		Before.Get<T>().Reserve(ChangedPoints.Num());
+		After.Get<T>().Reserve(ChangedPoints.Num());
+		for (const TPair<int32, T>& Point : ChangedPoints)
+		{
+			Indices.Add(Point.Key);
+			Before.Get<T>().Add(CurrentCurve.GetValue(Point.Key));
+			After.Get<T>().Add(Point.Value);
+		}
+		Metadata->RecordPropertyChange(InProperty, MoveTemp(Indices), MoveTemp(Before), MoveTemp(After));
+	}
+
+	const auto Curve = Metadata->FindCurve<T>(InProperty);
+	for (const TPair<int32, T>& Point : ChangedPoints)
+	{
+		Curve->SetValue(Point.Key, Point.Value);
+	}
+	Metadata->MarkPointsDirty(DirtyBegin, DirtyEnd);
+
+	SynchronizeMetadata();
+
+#if WITH_EDITOR
+	Metadata->PostEditChange();
+	if (bTransact)
+	{
+		GEngine->EndTransaction();
+	}
+#endif
+
+	OnMetadataChanged.Broadcast(this);
+
+	return ChangedPoints.Num();
+}
+
+int32 UMetaSplineComponent::SetMetadataFloatAtPoints(FName InProperty, const TArray<int32>& InIndices, const TArray<float>& InValues)
+{
+	if (InIndices.Num() != InValues.Num())
+	{
+		UE_LOG(LogMetaSpline, Warning, TEXT("SetMetadataFloatAtPoints: Got %d indices, but %d values."), InIndices.Num(), InValues.Num());
+		return 0;
+	}
+	return SetMetadataAtPoints<float>(InProperty, InIndices.Num(), [&](int32 i) { return TPair<int32, float>(InIndices[i], InValues[i]); });
+}
+
+int32 UMetaSplineComponent::SetMetadataVectorAtPoints(FName InProperty, const TArray<int32>& InIndices, const TArray<FVector>& InValues)
+{
+	if (InIndices.Num() != InValues.Num())
+	{
+		UE_LOG(LogMetaSpline, Warning, TEXT("SetMetadataVectorAtPoints: Got %d indices, but %d values."), InIndices.Num(), InValues.Num());
+		return 0;
+	}
+	return SetMetadataAtPoints<FVector>(InProperty, InIndices.Num(), [&](int32 i) { return TPair<int32, FVector>(InIndices[i], InValues[i]); });
+}
+
+int32 UMetaSplineComponent::FillMetadataFloat(FName InProperty, int32 InFirstIndex, int32 InCount, float InValue)
+{
+	return SetMetadataAtPoints<float>(InProperty, FMath::Max(InCount, 0), [&](int32 i) { return TPair<int32, float>(InFirstIndex + i, InValue); });
+}
+
+int32 UMetaSplineComponent::FillMetadataVector(FName InProperty, int32 InFirstIndex, int32 InCount, const FVector& InValue)
+{
+	return SetMetadataAtPoints<FVector>(InProperty, FMath::Max(InCount, 0), [&](int32 i) { return TPair<int32, FVector>(InFirstIndex + i, InValue); });
+}
+
+// -- Full record accessors --
+bool UMetaSplineComponent::EvaluateAllMetadataAtKey(float InKey, UObject* OutInstance) const
+{
+	return Metadata && OutInstance && Metadata->EvaluateAllAtKey(InKey, OutInstance->GetClass(), OutInstance);
+}
+
+bool UMetaSplineComponent::EvaluateAllMetadataAtKey(float InKey, const UScriptStruct* InStruct, void* OutStruct) const
+{
+	return Metadata && Metadata->EvaluateAllAtKey(InKey, InStruct, OutStruct);
+}
+
+// -- Distance based metadata accessors --
+void FMetaSplineDistanceIndex::Build(const FInterpCurveFloat& InReparamTable)
+{
+	const auto& Points = InReparamTable.Points;
+	NumTablePoints = Points.Num();
+	BucketStart.Reset();
+
+	const float Length = NumTablePoints > 0 ? Points.Last().InVal : 0.0f;
+	if (Length <= 0.0f)
+	{
+		InvBucketLength = 0.0f;
+		return;
+	}
+
+	// One bucket per table point keeps the number of points scanned per lookup close to one.
+	const int32 NumBuckets = NumTablePoints;
+	InvBucketLength = NumBuckets / Length;
+	BucketStart.SetNumUninitialized(NumBuckets);
+
+	int32 PointIndex = 0;
+	for (int32 Bucket = 0; Bucket < NumBuckets; Bucket++)
+	{
+		const float BucketDistance = Bucket / InvBucketLength;
+		while (PointIndex + 1 < NumTablePoints && Points[PointIndex + 1].InVal <= BucketDistance)
+		{
+			PointIndex++;
+		}
+		BucketStart[Bucket] = PointIndex;
+	}
+}
+
+void FMetaSplineDistanceIndex::Reset()
+{
+	BucketStart.Empty();
+	InvBucketLength = 0.0f;
+	NumTablePoints = 0;
+}
+
+float FMetaSplineDistanceIndex::GetKeyAtDistance(const FInterpCurveFloat& InReparamTable, float InDistance) const
+{
+	const auto& Points = InReparamTable.Points;
+	if (NumTablePoints != Points.Num() || BucketStart.Num() == 0)
+	{
+		return InReparamTable.Eval(InDistance, 0.0f);
+	}
+
+	const int32 LastPoint = NumTablePoints - 1;
+	if (InDistance <= Points[0].InVal)
+	{
+		return Points[0].OutVal;
+	}
+	if (InDistance >= Points[LastPoint].InVal)
+	{
+		return Points[LastPoint].OutVal;
+	}
+
+	int32 Index = BucketStart[FMath::Clamp(FMath::FloorToInt(InDistance * InvBucketLength), 0, BucketStart.Num() - 1)];
+	while (Index + 1 < LastPoint && Points[Index + 1].InVal <= InDistance)
+	{
+		Index++;
+	}
+
+	const auto& Prev = Points[Index];
+	const auto& Next = Points[Index + 1];
+	const float Diff = Next.InVal - Prev.InVal;
+	return Diff > 0.0f ? FMath::Lerp(Prev.OutVal, Next.OutVal, (InDistance - Prev.InVal) / Diff) : Prev.OutVal;
+}
+
+float UMetaSplineComponent::GetMetadataKeyAtDistance(float InDistance) const
+{
+	return DistanceIndex.GetKeyAtDistance(SplineCurves.ReparamTable, InDistance);
+}
+
+float UMetaSplineComponent::GetMetadataFloatAtDistance(FName InProperty, float InDistance) const
+{
+	return GetMetadataFloatAtKey(InProperty, GetMetadataKeyAtDistance(InDistance));
+}
+
+FVector UMetaSplineComponent::GetMetadataVectorAtDistance(FName InProperty, float InDistance) const
+{
+	return GetMetadataVectorAtKey(InProperty, GetMetadataKeyAtDistance(InDistance));
+}
+
+float UMetaSplineComponent::GetMetadataFloatAtDistance(const FMetaSplinePropertyHandle& InHandle, float InDistance) const
+{
+	return GetMetadataFloatAtKey(InHandle, GetMetadataKeyAtDistance(InDistance));
+}
+
+FVector UMetaSplineComponent::GetMetadataVectorAtDistance(const FMetaSplinePropertyHandle& InHandle, float InDistance) const
+{
+	return GetMetadataVectorAtKey(InHandle, GetMetadataKeyAtDistance(InDistance));
+}
+
+template<typename T>
+void UMetaSplineComponent::EvaluateBatchAtDistance(const FMetaSplinePropertyHandle& InHandle, TArrayView<const float> InDistances, TArrayView<T> OutValues) const
+{
+	TArray<float, TInlineAllocator<256>> Keys;
+	Keys.SetNumUninitialized(InDistances.Num());
+	for (int32 i = 0; i < InDistances.Num(); i++)
+	{
+		Keys[i] = GetMetadataKeyAtDistance(InDistances[i]);
+	}
+
+	EvaluatePropertyBatch<T>(Metadata, InHandle, Keys, OutValues);
+}
+
+void UMetaSplineComponent::EvaluateMetadataBatchAtDistance(const FMetaSplinePropertyHandle& InHandle, TArrayView<const float> InDistances, TArrayView<float> OutValues) const
+{
+	EvaluateBatchAtDistance<float>(InHandle, InDistances, OutValues);
+}
+
+void UMetaSplineComponent::EvaluateMetadataBatchAtDistance(const FMetaSplinePropertyHandle& InHandle, TArrayView<const float> InDistances, TArrayView<FVector> OutValues) const
+{
+	EvaluateBatchAtDistance<FVector>(InHandle, InDistances, OutValues);
+}
+
+TArray<float> UMetaSplineComponent::GetMetadataFloatAtDistances(const FMetaSplinePropertyHandle& InHandle, const TArray<float>& InDistances) const
+{
+	TArray<float> Values;
+	Values.SetNumUninitialized(InDistances.Num());
+	EvaluateMetadataBatchAtDistance(InHandle, InDistances, Values);
+	return Values;
+}
+
+TArray<FVector> UMetaSplineComponent::GetMetadataVectorAtDistances(const FMetaSplinePropertyHandle& InHandle, const TArray<float>& InDistances) const
+{
+	TArray<FVector> Values;
+	Values.SetNumUninitialized(InDistances.Num());
+	EvaluateMetadataBatchAtDistance(InHandle, InDistances, Values);
+	return Values;
+}
+
+float UMetaSplineComponent::GetMaxMetadataBakeError() const
+{
+	return Metadata ? Metadata->GetMaxBakeError() : 0.0f;
+}
+
+// -- Snapshots --
+TSharedPtr<const FMetaSplineSnapshot, ESPMode::ThreadSafe> UMetaSplineComponent::GetSnapshot() const
+{
+	FReadScopeLock Lock(SnapshotLock);
+	return Snapshot;
+}
+
+void UMetaSplineComponent::PublishSnapshot()
+{
+	TSharedPtr<const FMetaSplineSnapshot, ESPMode::ThreadSafe> NewSnapshot;
+	if (bPublishSnapshots && Metadata)
+	{
+		TSharedRef<FMetaSplineSnapshot::FSplineData, ESPMode::ThreadSafe> SplineData = MakeShared<FMetaSplineSnapshot::FSplineData, ESPMode::ThreadSafe>();
+		SplineData->SplineCurves = SplineCurves;
+		SplineData->DistanceIndex = DistanceIndex;
+		NewSnapshot = MakeShareable(new FMetaSplineSnapshot(SplineData, Metadata->MakeImmutableStorage(), GetComponentTransform()));
+	}
+
+	// Readers that already hold the previous snapshot keep it alive until they are done with it.
+	FWriteScopeLock Lock(SnapshotLock);
+	Snapshot = MoveTemp(NewSnapshot);
+}
+
 // -- Overrides --
 TStructOnScope<FActorComponentInstanceData> UMetaSplineComponent::GetComponentInstanceData() const
 {
@@ -68,7 +517,7 @@ TStructOnScope<FActorComponentInstanceData> UMetaSplineComponent::GetComponentIn
 	return InstanceData;
 }
 
-void UMetaSplineComponent::ApplyComponentInstanceData(struct FMetaSplineInstanceData* ComponentInstanceData, const bool bPostUCS)
+bool UMetaSplineComponent::ApplyComponentInstanceData(struct FMetaSplineInstanceData* ComponentInstanceData, const bool bPostUCS)
 {
 	check(ComponentInstanceData);
 
@@ -78,7 +527,7 @@ void UMetaSplineComponent::ApplyComponentInstanceData(struct FMetaSplineInstance
 		{
 			// Don't reapply the saved state after the UCS has run if we are inputting the points to it.
 			// This allows the UCS to work on the edited points and make its own changes.
-			return;
+			return false;
 		}
 		else
 		{
@@ -98,23 +547,45 @@ void UMetaSplineComponent::ApplyComponentInstanceData(struct FMetaSplineInstance
 		// Copy metadata to current component
 		if (Metadata && ComponentInstanceData->Metadata)
 		{
-			Metadata->Modify();
-			UEngine::CopyPropertiesForUnrelatedObjects(ComponentInstanceData->Metadata, Metadata);
+			Metadata->CopyMetadataFrom(*ComponentInstanceData->Metadata);
 		}
 
-		SetClosedLoop(ComponentInstanceData->bClosedLoop);
-
+		// The spline isn't updated here, the engine does that once it has restored the points.
 		check(LoopPositionOverrideProperty && LoopPositionProperty);
-
+		SetClosedLoop(ComponentInstanceData->bClosedLoop, false);
 		*LoopPositionOverrideProperty->ContainerPtrToValuePtr<bool>(this) = ComponentInstanceData->bClosedLoopPositionOverride;
 		*LoopPositionProperty->ContainerPtrToValuePtr<float>(this) = ComponentInstanceData->ClosedLoopPosition;
+	}
+
+	return true;
+}
 
+void UMetaSplineComponent::FinishApplyComponentInstanceData(struct FMetaSplineInstanceData* ComponentInstanceData, const bool bPostUCS)
+{
+	check(ComponentInstanceData);
+
+	if (ComponentInstanceData->bSplineHasBeenEdited)
+	{
 		bModifiedByConstructionScript = false;
 	}
+	else if (bPostUCS)
+	{
+		// The engine compares against the points from before the UCS, which were captured before their tangents and input keys
+		// were updated, so an unmodified spline would look modified and be read-only. Only compare what the user can edit.
+		bModifiedByConstructionScript = !MetaSplineComponent_Private::HasSamePoints(ComponentInstanceData->SplineCurvesPreUCS, SplineCurves);
+	}
 
-	UpdateSpline();
+	// The engine already updated the spline and the distance index along with it.
+	SynchronizeMetadata();
+}
+void UMetaSplineComponent::PreSave(const class ITargetPlatform* TargetPlatform)
+{
+	Super::PreSave(TargetPlatform);
 
-	SynchronizeProperties();
+	if (Metadata)
+	{
+		Metadata->SaveCleanState(GetMetadataStateHash(), GetNumberOfSplinePoints(), 0.0f, bStationaryEndpoints);
+	}
 }
 
 void UMetaSplineComponent::PostLoad()
@@ -123,6 +594,23 @@ void UMetaSplineComponent::PostLoad()
 	
 	if (Metadata)
 	{
+		Metadata->ConditionalPostLoad();
+
+		// Metadata that was in sync when saved already has its keys, loop state and tangents.
+		if (Metadata->RestoreCleanState(GetMetadataStateHash(), GetNumberOfSplinePoints(), 0.0f, bStationaryEndpoints))
+		{
+			DistanceIndex.Build(SplineCurves.ReparamTable);
+
+			if (bBakeMetadata)
+			{
+				Metadata->BakeTracks(GetDefault<UMetaSplineSettings>()->BakeSamplesPerSegment);
+			}
+
+			Metadata->ShareStorage();
+			PublishSnapshot();
+			return;
+		}
+
 		if (!Metadata->HasValidMetadataClass())
 		{
 			Metadata->UpdateMetadataClass(MetadataClass ? MetadataClass.Get() : nullptr);
@@ -131,6 +619,69 @@ void UMetaSplineComponent::PostLoad()
 	}
 }
 
+void UMetaSplineComponent::UpdateSpline()
+{
+	Super::UpdateSpline();
+
+	// The metadata may not match the new points yet, so the snapshot is published once SynchronizeMetadata() has caught up.
+	DistanceIndex.Build(SplineCurves.ReparamTable);
+}
+
+void UMetaSplineComponent::OnRegister()
+{
+	Super::OnRegister();
+
+	// Snapshots aren't duplicated along with the component.
+	if (bPublishSnapshots && !Snapshot.IsValid())
+	{
+		PublishSnapshot();
+	}
+
+	if (UMetaSplineSubsystem* Subsystem = UMetaSplineSubsystem::Get(GetWorld()))
+	{
+		Subsystem->RegisterComponent(this);
+	}
+}
+
+void UMetaSplineComponent::OnUnregister()
+{
+	if (UMetaSplineSubsystem* Subsystem = UMetaSplineSubsystem::Get(GetWorld()))
+	{
+		Subsystem->UnregisterComponent(this);
+	}
+
+	Super::OnUnregister();
+}
+
+void UMetaSplineComponent::UpdateBounds()
+{
+	const FBoxSphereBounds PreviousBounds = Bounds;
+
+	Super::UpdateBounds();
+
+	if (IsRegistered() && (Bounds.Origin != PreviousBounds.Origin || Bounds.BoxExtent != PreviousBounds.BoxExtent))
+	{
+		if (UMetaSplineSubsystem* Subsystem = UMetaSplineSubsystem::Get(GetWorld()))
+		{
+			Subsystem->MarkBoundsDirty(this);
+		}
+	}
+}
+
+void UMetaSplineComponent::OnUpdateTransform(EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+	Super::OnUpdateTransform(UpdateTransformFlags, Teleport);
+
+	// Only the transform changed, so the new snapshot shares the spline and metadata with the previous one.
+	if (Snapshot.IsValid())
+	{
+		TSharedPtr<const FMetaSplineSnapshot, ESPMode::ThreadSafe> NewSnapshot = MakeShareable(new FMetaSplineSnapshot(Snapshot->SplineData, Snapshot->Storage, GetComponentTransform()));
+
+		FWriteScopeLock Lock(SnapshotLock);
+		Snapshot = MoveTemp(NewSnapshot);
+	}
+}
+
 #if WITH_EDITOR
 void UMetaSplineComponent::PostEditImport()
 {
@@ -161,46 +712,92 @@ void UMetaSplineComponent::PostEditChangeChainProperty(FPropertyChangedChainEven
 #endif
 
 void UMetaSplineComponent::SynchronizeProperties()
+{
+	DistanceIndex.Build(SplineCurves.ReparamTable);
+
+	SynchronizeMetadata();
+}
+
+void UMetaSplineComponent::SynchronizeMetadata()
 {
 	if (Metadata)
 	{
+		Metadata->SetStorage(MetadataStorage);
 		Metadata->Fixup(GetNumberOfSplinePoints(), this);
 
-		Metadata->TransformCurves([this](auto& InOutCurve)
+		if (IsClosedLoop())
 		{
-			if (IsClosedLoop())
-			{
-				const float LastKey = InOutCurve.Points.Num() > 0 ? InOutCurve.Points.Last().InVal : 0.0f;
+			const float LastKey = static_cast<float>(FMath::Max(Metadata->NumPoints - 1, 0));
 
-				// NOTE: This is all incredibly stupid and should not have to be done. For some reason these variables are private instead of protected,
-				// and there is no way of accessing them except like this.
-				check(LoopPositionOverrideProperty && LoopPositionProperty);
+			// NOTE: This is all incredibly stupid and should not have to be done. For some reason these variables are private instead of protected,
+			// and there is no way of accessing them except like this.
+			check(LoopPositionOverrideProperty && LoopPositionProperty);
 
-				const bool bLocalLoopPositionOverride = *LoopPositionOverrideProperty->ContainerPtrToValuePtr<bool>(this);
-				const float LocalLoopPosition = *LoopPositionProperty->ContainerPtrToValuePtr<float>(this);
+			const bool bLocalLoopPositionOverride = *LoopPositionOverrideProperty->ContainerPtrToValuePtr<bool>(this);
+			const float LocalLoopPosition = *LoopPositionProperty->ContainerPtrToValuePtr<float>(this);
 
-				const float LoopKey = bLocalLoopPositionOverride ? LocalLoopPosition : LastKey + 1.0f;
-				InOutCurve.SetLoopKey(LoopKey);
-			}
-			else
-			{
-				InOutCurve.ClearLoopKey();
-			}
+			const float LoopKey = bLocalLoopPositionOverride ? LocalLoopPosition : LastKey + 1.0f;
+			Metadata->SetLoopKey(LoopKey);
+		}
+		else
+		{
+			Metadata->ClearLoopKey();
+		}
+
+		Metadata->AutoSetTangents(0.0f, bStationaryEndpoints);
+
+		if (bBakeMetadata)
+		{
+			Metadata->BakeTracks(GetDefault<UMetaSplineSettings>()->BakeSamplesPerSegment);
+		}
 
-			InOutCurve.AutoSetTangents(0.0f, bStationaryEndpoints);
-		});
+		// Only share metadata that is fully synchronized, so identical splines end up with identical storage.
+		Metadata->ShareStorage();
 	}
+
+	PublishSnapshot();
+}
+
+uint32 UMetaSplineComponent::GetMetadataStateHash() const
+{
+	check(LoopPositionOverrideProperty && LoopPositionProperty);
+
+	uint32 Hash = GetTypeHash(GetNumberOfSplinePoints());
+	Hash = HashCombine(Hash, GetTypeHash(IsClosedLoop()));
+	Hash = HashCombine(Hash, GetTypeHash(*LoopPositionOverrideProperty->ContainerPtrToValuePtr<bool>(this)));
+	Hash = HashCombine(Hash, GetTypeHash(*LoopPositionProperty->ContainerPtrToValuePtr<float>(this)));
+	Hash = HashCombine(Hash, GetTypeHash(bStationaryEndpoints));
+	Hash = HashCombine(Hash, GetTypeHash(MetadataStorage));
+
+	// FName hashes differ between sessions, so hash the strings. The properties are included so a modified meta class is detected.
+	if (MetadataClass)
+	{
+		Hash = HashCombine(Hash, FCrc::StrCrc32(*MetadataClass->GetPathName()));
+		for (const FMetaSplinePropertyLayout& Property : FMetaSplineStructLayout::Get(MetadataClass).GetProperties())
+		{
+			Hash = HashCombine(Hash, FCrc::StrCrc32(*Property.Name.ToString()));
+			Hash = HashCombine(Hash, GetTypeHash(Property.Type));
+		}
+	}
+
+	// Zero means not clean.
+	return Hash != 0 ? Hash : 1;
 }
 
 void FMetaSplineInstanceData::ApplyToComponent(UActorComponent* Component, const ECacheApplyPhase CacheApplyPhase)
 {
 	if (UMetaSplineComponent* SplineComp = CastChecked<UMetaSplineComponent>(Component))
 	{
-		// This ensures there is no stale data causing issues where the spline is marked as read-only even though it shouldn't.
-		// There might be a better solution, but this works.
-		SplineComp->UpdateSpline();
+		// The metadata and loop settings are applied before the points, so the one spline update the engine does after
+		// restoring the points already uses them.
+		const bool bPostUCS = (CacheApplyPhase == ECacheApplyPhase::PostUserConstructionScript);
+		const bool bApplied = SplineComp->ApplyComponentInstanceData(this, bPostUCS);
 
 		Super::ApplyToComponent(Component, CacheApplyPhase);
-		SplineComp->ApplyComponentInstanceData(this, (CacheApplyPhase == ECacheApplyPhase::PostUserConstructionScript));
+
+		if (bApplied)
+		{
+			SplineComp->FinishApplyComponentInstanceData(this, bPostUCS);
+		}
 	}
 }
@@ -0,0 +1,119 @@
+// Copyright(c) 2021 Viktor Pramberg
+#include "MetaSplineCompression.h"
+
+namespace MetaSplineCompression_Private
+{
+	constexpr float MaxFixedPoint = 65535.0f;
+	constexpr int32 MaxDelta = 32767;
+}
+
+void FMetaSplineCompression::EncodeComponents(EMetaSplineCompression InCompression, const float* InValues, int32 InNumValues, int32 InNumComponents, FMetaSplineEncodedTrack& OutTrack)
+{
+	using namespace MetaSplineCompression_Private;
+
+	const int32 NumFloats = InNumValues * InNumComponents;
+	OutTrack.Params.Reset();
+	OutTrack.Data.SetNumUninitialized(NumFloats);
+
+	if (InCompression == EMetaSplineCompression::Half)
+	{
+		for (int32 i = 0; i < NumFloats; i++)
+		{
+			OutTrack.Data[i] = FFloat16(InValues[i]).Encoded;
+		}
+		return;
+	}
+
+	OutTrack.Params.SetNumUninitialized(InNumComponents * 2);
+	for (int32 Component = 0; Component < InNumComponents; Component++)
+	{
+		if (InCompression == EMetaSplineCompression::FixedPoint)
+		{
+			float Min = InNumValues > 0 ? InValues[Component] : 0.0f;
+			float Max = Min;
+			for (int32 i = Component; i < NumFloats; i += InNumComponents)
+			{
+				Min = FMath::Min(Min, InValues[i]);
+				Max = FMath::Max(Max, InValues[i]);
+			}
+
+			const float Scale = Max > Min ? (Max - Min) / MaxFixedPoint : 1.0f;
+			OutTrack.Params[Component * 2 + 0] = Min;
+			OutTrack.Params[Component * 2 + 1] = Scale;
+
+			for (int32 i = Component; i < NumFloats; i += InNumComponents)
+			{
+				OutTrack.Data[i] = static_cast<uint16>(FMath::Clamp(FMath::RoundToInt((InValues[i] - Min) / Scale), 0, static_cast<int32>(MaxFixedPoint)));
+			}
+		}
+		else
+		{
+			float LargestDelta = 0.0f;
+			for (int32 i = Component + InNumComponents; i < NumFloats; i += InNumComponents)
+			{
+				LargestDelta = FMath::Max(LargestDelta, FMath::Abs(InValues[i] - InValues[i - InNumComponents]));
+			}
+
+			const float First = InNumValues > 0 ? InValues[Component] : 0.0f;
+			const float Step = LargestDelta > 0.0f ? LargestDelta / (MaxDelta - 1) : 1.0f;
+			OutTrack.Params[Component * 2 + 0] = First;
+			OutTrack.Params[Component * 2 + 1] = Step;
+
+			// Deltas are taken from the decoded value rather than the source, so the error doesn't accumulate along the track.
+			float Decoded = First;
+			for (int32 i = Component; i < NumFloats; i += InNumComponents)
+			{
+				const int32 Delta = i == Component ? 0 : FMath::Clamp(FMath::RoundToInt((InValues[i] - Decoded) / Step), -MaxDelta, MaxDelta);
+				Decoded += Delta * Step;
+				OutTrack.Data[i] = static_cast<uint16>(static_cast<int16>(Delta));
+			}
+		}
+	}
+}
+
+void FMetaSplineCompression::DecodeComponents(const FMetaSplineEncodedTrack& InTrack, float* OutValues, int32 InNumValues, int32 InNumComponents)
+{
+	const int32 NumFloats = InNumValues * InNumComponents;
+	const uint16* Data = InTrack.Data.GetData();
+
+	switch (InTrack.Compression)
+	{
+	case EMetaSplineCompression::Half:
+		for (int32 i = 0; i < NumFloats; i++)
+		{
+			FFloat16 Value;
+			Value.Encoded = Data[i];
+			OutValues[i] = Value.GetFloat();
+		}
+		break;
+
+	case EMetaSplineCompression::FixedPoint:
+		for (int32 Component = 0; Component < InNumComponents; Component++)
+		{
+			const float Min = InTrack.Params[Component * 2 + 0];
+			const float Scale = InTrack.Params[Component * 2 + 1];
+			for (int32 i = Component; i < NumFloats; i += InNumComponents)
+			{
+				OutValues[i] = Min + Data[i] * Scale;
+			}
+		}
+		break;
+
+	case EMetaSplineCompression::Delta:
+		for (int32 Component = 0; Component < InNumComponents; Component++)
+		{
+			const float Step = InTrack.Params[Component * 2 + 1];
+			float Decoded = InTrack.Params[Component * 2 + 0];
+			for (int32 i = Component; i < NumFloats; i += InNumComponents)
+			{
+				Decoded += static_cast<int16>(Data[i]) * Step;
+				OutValues[i] = Decoded;
+			}
+		}
+		break;
+
+	default:
+		checkNoEntry();
+		break;
+	}
+}
@@ -0,0 +1,67 @@
+// Copyright(c) 2021 Viktor Pramberg
+#pragma once
+#include "CoreMinimal.h"
+#include "MetaSplineTrack.h"
+
+/**
+ * The values of a packed track in one of the EMetaSplineCompression encodings.
+ */
+struct FMetaSplineEncodedTrack
+{
+	EMetaSplineCompression Compression = EMetaSplineCompression::None;
+
+	// Two per component. The minimum and scale for fixed point, and the first value and step for delta encoding.
+	TArray<float> Params;
+
+	// One per component per point, interleaved the same way as the components of the value type.
+	TArray<uint16> Data;
+
+	// The compression is stored by the owner of the track, ahead of it.
+	friend FArchive& operator<<(FArchive& Ar, FMetaSplineEncodedTrack& Track)
+	{
+		Track.Params.BulkSerialize(Ar);
+		Track.Data.BulkSerialize(Ar);
+		return Ar;
+	}
+};
+
+/**
+ * Encodes and decodes packed track values. Every supported value type is a run of float components, so the encodings work on those.
+ */
+class FMetaSplineCompression
+{
+public:
+	template<typename T>
+	static void Encode(EMetaSplineCompression InCompression, const TArray<T>& InValues, FMetaSplineEncodedTrack& OutTrack)
+	{
+		OutTrack.Compression = InCompression;
+		EncodeComponents(InCompression, reinterpret_cast<const float*>(InValues.GetData()), InValues.Num(), NumComponents<T>(), OutTrack);
+	}
+
+	template<typename T>
+	static void Decode(const FMetaSplineEncodedTrack& InTrack, TArray<T>& OutValues)
+	{
+		OutValues.SetNumUninitialized(InTrack.Data.Num() / NumComponents<T>());
+		DecodeComponents(InTrack, reinterpret_cast<float*>(OutValues.GetData()), OutValues.Num(), NumComponents<T>());
+
+		if constexpr (TIsSame<T, FQuat>::Value)
+		{
+			// Quantization error leaves quaternions slightly denormalized.
+			for (FQuat& Value : OutValues)
+			{
+				Value.Normalize();
+			}
+		}
+	}
+
+private:
+	template<typename T>
+	static constexpr int32 NumComponents()
+	{
+		static_assert(sizeof(T) % sizeof(float) == 0, "Value type must consist of floats");
+		return sizeof(T) / sizeof(float);
+	}
+
+	static void EncodeComponents(EMetaSplineCompression InCompression, const float* InValues, int32 InNumValues, int32 InNumComponents, FMetaSplineEncodedTrack& OutTrack);
+	static void DecodeComponents(const FMetaSplineEncodedTrack& InTrack, float* OutValues, int32 InNumValues, int32 InNumComponents);
+};
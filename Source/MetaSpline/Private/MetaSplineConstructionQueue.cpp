@@ -0,0 +1,79 @@
+// Copyright(c) 2021 Viktor Pramberg
+#include "MetaSplineConstructionQueue.h"
+
+#if WITH_EDITOR
+#include "MetaSplineSettings.h"
+#include "Containers/Ticker.h"
+#include "GameFramework/Actor.h"
+
+FMetaSplineConstructionQueue* FMetaSplineConstructionQueue::Instance = nullptr;
+
+FMetaSplineConstructionQueue::FMetaSplineConstructionQueue()
+{
+	check(!Instance);
+	Instance = this;
+
+	TickerHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FMetaSplineConstructionQueue::Tick));
+}
+
+FMetaSplineConstructionQueue::~FMetaSplineConstructionQueue()
+{
+	FTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+
+	Instance = nullptr;
+}
+
+void FMetaSplineConstructionQueue::RequestRerun(AActor* InActor)
+{
+	if (!InActor)
+	{
+		return;
+	}
+
+	if (!Instance || !GetDefault<UMetaSplineSettings>()->bDeferConstructionScriptReruns)
+	{
+		InActor->PostEditMove(false);
+		return;
+	}
+
+	Instance->PendingActors.Add(InActor);
+}
+
+void FMetaSplineConstructionQueue::RequestDeferredRerun(AActor* InActor)
+{
+	if (!InActor)
+	{
+		return;
+	}
+
+	if (!Instance)
+	{
+		InActor->PostEditMove(false);
+		return;
+	}
+
+	Instance->PendingActors.Add(InActor);
+}
+
+bool FMetaSplineConstructionQueue::Tick(float InDeltaTime)
+{
+	if (PendingActors.Num() == 0)
+	{
+		return true;
+	}
+
+	// Reruns can cause new requests, which are handled on the next tick.
+	TSet<TWeakObjectPtr<AActor>> Actors = MoveTemp(PendingActors);
+	PendingActors.Reset();
+
+	for (const TWeakObjectPtr<AActor>& Actor : Actors)
+	{
+		if (Actor.IsValid())
+		{
+			Actor->PostEditMove(false);
+		}
+	}
+
+	return true;
+}
+#endif
@@ -0,0 +1,37 @@
+// Copyright(c) 2021 Viktor Pramberg
+#pragma once
+#include "CoreMinimal.h"
+
+#if WITH_EDITOR
+class AActor;
+
+/**
+ * Collects actors whose construction scripts have to rerun after their metadata changed, and reruns each of them once per tick.
+ * Undoing a multi step edit or a transaction touching many splines would otherwise rerun them for every object in the transaction.
+ */
+class FMetaSplineConstructionQueue
+{
+public:
+	~FMetaSplineConstructionQueue();
+
+	/** Reruns the construction script of InActor on the next tick, or right away if deferring is disabled in the project settings. */
+	static void RequestRerun(AActor* InActor);
+
+	/** Same as RequestRerun(), but always waits for the next tick. For requests made while a transaction is still being applied. */
+	static void RequestDeferredRerun(AActor* InActor);
+
+private:
+	FMetaSplineConstructionQueue();
+
+	bool Tick(float InDeltaTime);
+
+private:
+	TSet<TWeakObjectPtr<AActor>> PendingActors;
+
+	FDelegateHandle TickerHandle;
+
+	static FMetaSplineConstructionQueue* Instance;
+
+	friend class FMetaSplineModule;
+};
+#endif
@@ -0,0 +1,287 @@
+// Copyright(c) 2021 Viktor Pramberg
+#include "MetaSplineCursor.h"
+#include "MetaSplineComponent.h"
+#include "MetaSplinePropertyLayout.h"
+#include "MetaSplineTemplateHelpers.h"
+
+namespace MetaSplineCursor_Private
+{
+	float Wrap(float InValue, float InPeriod)
+	{
+		const float Result = FMath::Fmod(InValue, InPeriod);
+		return Result < 0.0f ? Result + InPeriod : Result;
+	}
+
+	// The key where the spline ends. For closed loops this is the loop key SynchronizeProperties() gives both the spline and the metadata.
+	float GetEndKey(const FInterpCurveVector& InPosition)
+	{
+		const float LastKey = static_cast<float>(FMath::Max(InPosition.Points.Num() - 1, 0));
+		return InPosition.bIsLooped ? LastKey + InPosition.LoopKeyOffset : LastKey;
+	}
+
+	float GetLength(const FInterpCurveFloat& InReparamTable)
+	{
+		return InReparamTable.Points.Num() > 0 ? InReparamTable.Points.Last().InVal : 0.0f;
+	}
+}
+
+FMetaSplineCursor::FMetaSplineCursor(const UMetaSplineComponent* InSpline, TArrayView<const FName> InProperties) : Spline(InSpline)
+{
+	if (!InSpline)
+	{
+		return;
+	}
+
+	const FMetaSplineStructLayout& Layout = FMetaSplineStructLayout::Get(InSpline->MetadataClass);
+	for (const FName Name : InProperties)
+	{
+		const FMetaSplinePropertyLayout* Property = Layout.Find(Name);
+		if (!Property || Property->Type == EMetaSplinePropertyType::Unsupported)
+		{
+			continue;
+		}
+
+		int32 ValueIndex = INDEX_NONE;
+		ForEachMetaSplineType([this, Property, &ValueIndex](auto Tag)
+		{
+			using T = typename decltype(Tag)::Type;
+			if (Property->Type == TMetaSplinePropertyType<T>::Value)
+			{
+				ValueIndex = Values.Get<T>().Add(T(ForceInit));
+			}
+		});
+
+		Properties.Add({ InSpline->ResolveMetadataProperty(Name), Property->Type, ValueIndex });
+	}
+
+	SetKey(0.0f);
+}
+
+const FSplineCurves* FMetaSplineCursor::GetSplineCurves()
+{
+	const UMetaSplineComponent* SplineComponent = Spline.Get();
+	if (!SplineComponent)
+	{
+		return nullptr;
+	}
+
+	const FSplineCurves& Curves = SplineComponent->SplineCurves;
+	if (Curves.Version != SplineVersion)
+	{
+		SplineVersion = Curves.Version;
+		ReparamIndex = 0;
+		SegmentIndex = SegmentNextIndex = INDEX_NONE;
+	}
+	return &Curves;
+}
+
+template<bool bByDistance>
+float FMetaSplineCursor::SeekReparamTable(const FInterpCurveFloat& InTable, float InValue)
+{
+	// Distances are the input values of the table and keys the output values. Both increase along the table.
+	const auto GetValue = [&InTable](int32 Index) { return bByDistance ? InTable.Points[Index].InVal : InTable.Points[Index].OutVal; };
+
+	const int32 LastSegment = FMath::Max(InTable.Points.Num() - 2, 0);
+	ReparamIndex = FMath::Clamp(ReparamIndex, 0, LastSegment);
+
+	// The cursor usually moves a short way, so only a few entries are stepped over.
+	while (ReparamIndex < LastSegment && GetValue(ReparamIndex + 1) <= InValue)
+	{
+		ReparamIndex++;
+	}
+	while (ReparamIndex > 0 && GetValue(ReparamIndex) > InValue)
+	{
+		ReparamIndex--;
+	}
+
+	if (InTable.Points.Num() < 2)
+	{
+		return 0.0f;
+	}
+
+	const float Diff = GetValue(ReparamIndex + 1) - GetValue(ReparamIndex);
+	return Diff > 0.0f ? FMath::Clamp((InValue - GetValue(ReparamIndex)) / Diff, 0.0f, 1.0f) : 0.0f;
+}
+
+void FMetaSplineCursor::SetKey(float InKey)
+{
+	const FSplineCurves* Curves = GetSplineCurves();
+	if (!Curves)
+	{
+		return;
+	}
+
+	const FInterpCurveFloat& Table = Curves->ReparamTable;
+	Key = FMath::Clamp(InKey, 0.0f, MetaSplineCursor_Private::GetEndKey(Curves->Position));
+
+	const float Alpha = SeekReparamTable<false>(Table, Key);
+	Distance = Table.Points.Num() > 0 ? Table.Points[ReparamIndex].InVal : 0.0f;
+	if (Table.Points.IsValidIndex(ReparamIndex + 1))
+	{
+		Distance = FMath::Lerp(Distance, Table.Points[ReparamIndex + 1].InVal, Alpha);
+	}
+
+	Evaluate(*Curves);
+}
+
+void FMetaSplineCursor::SetDistance(float InDistance)
+{
+	const FSplineCurves* Curves = GetSplineCurves();
+	if (!Curves)
+	{
+		return;
+	}
+
+	const FInterpCurveFloat& Table = Curves->ReparamTable;
+	Distance = FMath::Clamp(InDistance, 0.0f, MetaSplineCursor_Private::GetLength(Table));
+
+	// Same result as FMetaSplineDistanceIndex::GetKeyAtDistance().
+	const float Alpha = SeekReparamTable<true>(Table, Distance);
+	Key = Table.Points.Num() > 0 ? Table.Points[ReparamIndex].OutVal : 0.0f;
+	if (Table.Points.IsValidIndex(ReparamIndex + 1))
+	{
+		Key = FMath::Lerp(Key, Table.Points[ReparamIndex + 1].OutVal, Alpha);
+	}
+
+	Evaluate(*Curves);
+}
+
+bool FMetaSplineCursor::AdvanceByKey(float InDeltaKey)
+{
+	const FSplineCurves* Curves = GetSplineCurves();
+	if (!Curves)
+	{
+		return false;
+	}
+
+	const float EndKey = MetaSplineCursor_Private::GetEndKey(Curves->Position);
+	const float NewKey = Key + InDeltaKey;
+	if (Curves->Position.bIsLooped && EndKey > 0.0f)
+	{
+		const float WrappedKey = MetaSplineCursor_Private::Wrap(NewKey, EndKey);
+		if (WrappedKey != NewKey)
+		{
+			// Start scanning the table from the end the cursor wrapped around to.
+			ReparamIndex = InDeltaKey > 0.0f ? 0 : MAX_int32;
+		}
+		SetKey(WrappedKey);
+		return true;
+	}
+
+	SetKey(NewKey);
+	return NewKey >= 0.0f && NewKey <= EndKey;
+}
+
+bool FMetaSplineCursor::AdvanceByDistance(float InDeltaDistance)
+{
+	const FSplineCurves* Curves = GetSplineCurves();
+	if (!Curves)
+	{
+		return false;
+	}
+
+	const float Length = MetaSplineCursor_Private::GetLength(Curves->ReparamTable);
+	const float NewDistance = Distance + InDeltaDistance;
+	if (Curves->Position.bIsLooped && Length > 0.0f)
+	{
+		const float WrappedDistance = MetaSplineCursor_Private::Wrap(NewDistance, Length);
+		if (WrappedDistance != NewDistance)
+		{
+			ReparamIndex = InDeltaDistance > 0.0f ? 0 : MAX_int32;
+		}
+		SetDistance(WrappedDistance);
+		return true;
+	}
+
+	SetDistance(NewDistance);
+	return NewDistance >= 0.0f && NewDistance <= Length;
+}
+
+// Wrapper struct that can be passed to FMetaSplineTemplateHelpers::ExecuteOnType, that evaluates a requested property at a segment.
+template<typename T>
+struct FEvaluateCursorProperty
+{
+	static void Execute(const UMetaSplineMetadata* InMetadata, const FMetaSplineCursor::FRequestedProperty& InProperty, const FMetaSplineSegment& InSegment, FMetaSplineCursor::FValues& OutValues)
+	{
+		T& Value = OutValues.Get<T>()[InProperty.ValueIndex];
+
+		const auto Curve = InMetadata ? InMetadata->FindCurve<T>(InProperty.Handle) : TMetaSplineCurveView<const T>();
+		if (!Curve || InSegment.Index >= Curve.Num() || InSegment.NextIndex >= Curve.Num())
+		{
+			Value = T(ForceInit);
+			return;
+		}
+		Value = Curve->Eval(InSegment);
+	}
+};
+
+void FMetaSplineCursor::Evaluate(const FSplineCurves& InCurves)
+{
+	const FInterpCurveVector& Position = InCurves.Position;
+
+	// Metadata keys are the same as spline keys, so the segment is shared by the location and all properties.
+	const FMetaSplineSegment Segment = FMetaSplineSegment::Find(Key, Position.Points.Num(), Position.bIsLooped, Position.LoopKeyOffset);
+	if (!Segment.IsValid())
+	{
+		return;
+	}
+
+	if (Segment.Index != SegmentIndex || Segment.NextIndex != SegmentNextIndex)
+	{
+		SegmentIndex = Segment.Index;
+		SegmentNextIndex = Segment.NextIndex;
+
+		const FInterpCurvePoint<FVector>& Prev = Position.Points[Segment.Index];
+		const FInterpCurvePoint<FVector>& Next = Position.Points[Segment.NextIndex];
+
+		A = B = C = FVector::ZeroVector;
+		D = Prev.OutVal;
+		if (Segment.Diff > 0.0f && Prev.InterpMode == CIM_Linear)
+		{
+			C = Next.OutVal - Prev.OutVal;
+		}
+		else if (Segment.Diff > 0.0f && Prev.InterpMode != CIM_Constant)
+		{
+			// The Hermite basis of FMath::CubicInterp(), expanded into a polynomial in Alpha.
+			const FVector PrevTangent = Prev.LeaveTangent * Segment.Diff;
+			const FVector NextTangent = Next.ArriveTangent * Segment.Diff;
+			A = 2.0f * Prev.OutVal + PrevTangent - 2.0f * Next.OutVal + NextTangent;
+			B = -3.0f * Prev.OutVal - 2.0f * PrevTangent + 3.0f * Next.OutVal - NextTangent;
+			C = PrevTangent;
+		}
+	}
+
+	const float Alpha = Segment.Alpha;
+	Location = Spline->GetComponentTransform().TransformPosition(((A * Alpha + B) * Alpha + C) * Alpha + D);
+
+	const UMetaSplineMetadata* Metadata = Cast<UMetaSplineMetadata>(Spline->GetSplinePointsMetadata());
+	for (const FRequestedProperty& Property : Properties)
+	{
+		FMetaSplineTemplateHelpers::ExecuteOnType<FEvaluateCursorProperty>(Property.Type, Metadata, Property, Segment, Values);
+	}
+}
+
+FMetaSplineCursor UMetaSplineCursorLibrary::MakeMetaSplineCursor(const UMetaSplineComponent* InSpline, const TArray<FName>& InProperties)
+{
+	return FMetaSplineCursor(InSpline, InProperties);
+}
+
+bool UMetaSplineCursorLibrary::AdvanceMetaSplineCursorByKey(FMetaSplineCursor& InOutCursor, float InDeltaKey)
+{
+	return InOutCursor.AdvanceByKey(InDeltaKey);
+}
+
+bool UMetaSplineCursorLibrary::AdvanceMetaSplineCursorByDistance(FMetaSplineCursor& InOutCursor, float InDeltaDistance)
+{
+	return InOutCursor.AdvanceByDistance(InDeltaDistance);
+}
+
+void UMetaSplineCursorLibrary::SetMetaSplineCursorKey(FMetaSplineCursor& InOutCursor, float InKey)
+{
+	InOutCursor.SetKey(InKey);
+}
+
+void UMetaSplineCursorLibrary::SetMetaSplineCursorDistance(FMetaSplineCursor& InOutCursor, float InDistance)
+{
+	InOutCursor.SetDistance(InDistance);
+}
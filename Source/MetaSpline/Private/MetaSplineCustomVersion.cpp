@@ -0,0 +1,7 @@
+// Copyright(c) 2021 Viktor Pramberg
+#include "MetaSplineCustomVersion.h"
+#include "Serialization/CustomVersion.h"
+
+const FGuid FMetaSplineCustomVersion::GUID(0x5A3C71E2, 0x9B4D4F08, 0xA1E6C3D7, 0x2F8B4E19);
+
+FCustomVersionRegistration GRegisterMetaSplineCustomVersion(FMetaSplineCustomVersion::GUID, FMetaSplineCustomVersion::LatestVersion, TEXT("MetaSplineVer"));
@@ -0,0 +1,29 @@
+// Copyright(c) 2021 Viktor Pramberg
+#pragma once
+#include "CoreMinimal.h"
+#include "Misc/Guid.h"
+
+/**
+ * Custom serialization version for MetaSpline objects.
+ */
+struct FMetaSplineCustomVersion
+{
+	enum Type
+	{
+		BeforeCustomVersionWasAdded = 0,
+
+		// Packed tracks are stored as a schema header followed by raw value blocks, instead of as tagged properties.
+		BinaryTracks,
+
+		// The state of the owning component when the metadata was saved, so loading can skip synchronizing it.
+		CleanStateHash,
+
+		VersionPlusOne,
+		LatestVersion = VersionPlusOne - 1
+	};
+
+	const static FGuid GUID;
+
+private:
+	FMetaSplineCustomVersion() {}
+};
@@ -4,19 +4,67 @@
 #include "MetaSplineMetadata.h"
 #include "MetaSplineSettings.h"
 #include "MetaSplineTemplateHelpers.h"
+#include "MetaSplineSubsystem.h"
 
 #include "Debug/DebugDrawService.h"
 #include "Engine/Canvas.h"
 #include "CanvasItem.h"
+#include "CanvasTypes.h"
+#include "RenderUtils.h"
 #include "Fonts/FontMeasure.h"
+#include "Async/ParallelFor.h"
 
 #define LOCTEXT_NAMESPACE "MetaSplineDebugRenderer"
 
+namespace MetaSplineDebugRenderer_Private
+{
+	/**
+	 * Keeps the InNum elements with the largest depth, in no particular order.
+	 * The kept elements are in a heap with the smallest depth, the farthest point, on top, so every other element is rejected
+	 * after a single comparison.
+	 */
+	template<typename T, typename FGetDepth>
+	void KeepClosest(TArray<T>& InOutElements, int32 InNum, FGetDepth GetDepth)
+	{
+		if (InNum < 0 || InNum >= InOutElements.Num())
+		{
+			return;
+		}
+
+		const auto IsFarther = [&GetDepth](const T& A, const T& B) { return GetDepth(A) < GetDepth(B); };
+
+		TArray<T> Closest;
+		Closest.Reserve(InNum + 1);
+		for (const T& Element : InOutElements)
+		{
+			if (Closest.Num() < InNum)
+			{
+				Closest.HeapPush(Element, IsFarther);
+			}
+			else if (Closest.Num() > 0 && GetDepth(Element) > GetDepth(Closest.HeapTop()))
+			{
+				Closest.HeapPopDiscard(IsFarther, false);
+				Closest.HeapPush(Element, IsFarther);
+			}
+		}
+		InOutElements = MoveTemp(Closest);
+	}
+}
+
 FMetaSplineDebugRenderer::FMetaSplineDebugRenderer() : FontMeasure(FSlateApplication::Get().GetRenderer()->GetFontMeasureService())
 {
 	DelegateHandle = UDebugDrawService::Register(TEXT("Splines"), FDebugDrawDelegate::CreateRaw(this, &FMetaSplineDebugRenderer::Draw));
 }
 
+// Space between the text of a label and its border.
+static constexpr float LabelPadding = 10.0f;
+
+// Labels are drawn offset from the point, so the leader line stays visible.
+static FVector2D GetBoxPosition(const FMetaSplineDebugInfo& Info)
+{
+	return FVector2D(Info.ScreenPosition) + LabelPadding * 0.5f;
+}
+
 FMetaSplineDebugRenderer::~FMetaSplineDebugRenderer()
 {
 	UDebugDrawService::Unregister(DelegateHandle);
@@ -27,98 +75,158 @@ void FMetaSplineDebugRenderer::Draw(class UCanvas* Canvas, class APlayerControll
 	const FConvexVolume& Frustum = Canvas->SceneView->ViewFrustum;
 	UWorld* World = Canvas->SceneView->Family->Scene->GetWorld();
 
-	TArray<FMetaSplineDebugInfo> CurrentFrameInfos;
-	for (UMetaSplineComponent* Component : TObjectRange<UMetaSplineComponent>(RF_ClassDefaultObject, true, EInternalObjectFlags::PendingKill))
+	UMetaSplineSubsystem* Subsystem = UMetaSplineSubsystem::Get(World);
+	if (!Subsystem)
 	{
-		if (Component->GetWorld() != World)
-		{
-			continue;
-		}
+		return;
+	}
 
-		if (!Component->bDrawDebug || !Component->bDrawDebugMetadata)
+	TArray<UMetaSplineComponent*> VisibleComponents;
+	Subsystem->GetComponentsInFrustum(Frustum, VisibleComponents);
+
+	const UMetaSplineUserSettings* Settings = GetDefault<UMetaSplineUserSettings>();
+	const FVector ViewOrigin = Canvas->SceneView->ViewMatrices.GetViewOrigin();
+	const float MaxDistance = Settings->MaxDistance > 0.0f ? Settings->MaxDistance : BIG_NUMBER;
+
+	VisibleComponents.RemoveAllSwap([&ViewOrigin, MaxDistance](const UMetaSplineComponent* Component)
+	{
+		if (!IsValid(Component))
 		{
-			continue;
+			return true;
 		}
 
-		if (!Frustum.IntersectSphere(Component->Bounds.Origin, Component->Bounds.SphereRadius))
+		const bool bIsTooFar = FVector::Dist(Component->Bounds.Origin, ViewOrigin) - Component->Bounds.SphereRadius > MaxDistance;
+		return bIsTooFar || !Component->bDrawDebug || !Component->bDrawDebugMetadata;
+	});
+
+	// Project the points of each spline into its own buffer. No text is touched until the points to draw are known.
+	TArray<TArray<FCandidate>> ComponentCandidates;
+	ComponentCandidates.SetNum(VisibleComponents.Num());
+	ParallelFor(VisibleComponents.Num(), [&](int32 Index)
+	{
+		CollectCandidates(Canvas, VisibleComponents[Index], Index, ViewOrigin, MaxDistance, ComponentCandidates[Index]);
+	});
+
+	TArray<FCandidate> Candidates;
+	for (TArray<FCandidate>& Buffer : ComponentCandidates)
+	{
+		Candidates.Append(MoveTemp(Buffer));
+	}
+
+	// Forget the labels of splines that haven't been visible for a while.
+	for (auto It = LabelCaches.CreateIterator(); It; ++It)
+	{
+		if (!It.Key().IsValid() || GFrameCounter - It.Value().LastUsedFrame > 100)
 		{
-			continue;
+			It.RemoveCurrent();
 		}
-
-		CurrentFrameInfos.Append(CollectInfosFromSpline(Canvas, Component));
 	}
 
-	if (CurrentFrameInfos.Num() == 0)
+	if (Candidates.Num() == 0)
 	{
 		return;
 	}
 
+	// A larger depth is closer.
+	MetaSplineDebugRenderer_Private::KeepClosest(Candidates, Settings->NumberOfPoints, [](const FCandidate& Candidate) { return Candidate.ScreenPosition.Z; });
+
 	// Make sure we draw items back to front
-	CurrentFrameInfos.Sort([](const FMetaSplineDebugInfo& A, const FMetaSplineDebugInfo& B) { return A.ScreenPosition.Z < B.ScreenPosition.Z; });
+	Candidates.Sort([](const FCandidate& A, const FCandidate& B) { return A.ScreenPosition.Z < B.ScreenPosition.Z; });
 
-	const UMetaSplineUserSettings* Settings = GetDefault<UMetaSplineUserSettings>();
-	if (Settings->NumberOfPoints >= 0)
+	TArray<FMetaSplineDebugInfo> CurrentFrameInfos;
+	CurrentFrameInfos.Reserve(Candidates.Num());
+	for (const FCandidate& Candidate : Candidates)
 	{
-		CurrentFrameInfos.RemoveAt(0, FMath::Min(FMath::Max(CurrentFrameInfos.Num() - Settings->NumberOfPoints, 0), CurrentFrameInfos.Num()));
+		const UMetaSplineMetadata* Metadata = Cast<UMetaSplineMetadata>(VisibleComponents[Candidate.Component]->GetSplinePointsMetadata());
+		const FLabel& Label = GetLabel(*Metadata, Candidate.Point);
+		CurrentFrameInfos.Add({ Label.Text, Candidate.ScreenPosition, Label.Size });
 	}
 
-	UFont* Font(GEngine->GetTinyFont());
-	const FSlateFontInfo& FontInfo(Font->GetLegacySlateFontInfo());
-
-	for (FMetaSplineDebugInfo& Info : CurrentFrameInfos)
-	{
-		const FVector2D DrawPosition = FVector2D(Info.ScreenPosition) + 10.0f;
+	// Backgrounds, borders and leader lines all go into one triangle and one line batch, and text is drawn on top of them
+	// afterwards, instead of issuing separate canvas items for every label. The canvas renders its batches in the order they
+	// were requested, so the line batch is only fetched once the backgrounds have been drawn.
+	const FLinearColor BackgroundColor = FLinearColor::Black.CopyWithNewOpacity(0.5f);
+	const FLinearColor LineColor = FLinearColor::Gray.CopyWithNewOpacity(0.75f);
 
-		const FVector2D TextSize = FontMeasure->Measure(Info.Text, FontInfo);
-		const FVector2D BoxSize = TextSize + 10.0f;
+	TArray<FCanvasUVTri> Triangles;
+	Triangles.Reserve(CurrentFrameInfos.Num() * 2);
 
-		const FVector2D PaddingDiff = BoxSize - TextSize;
-		const FVector2D BoxPosition = DrawPosition - PaddingDiff * 0.5f;
-
-		{
-			FCanvasTileItem Background(BoxPosition, BoxSize, FLinearColor::Black.CopyWithNewOpacity(0.5f));
-			Background.BlendMode = SE_BLEND_Translucent;
+	for (const FMetaSplineDebugInfo& Info : CurrentFrameInfos)
+	{
+		const FVector2D BoxPosition = GetBoxPosition(Info);
+		const FVector2D BoxSize = Info.TextSize + LabelPadding;
+
+		const FVector TopLeft(BoxPosition, 0.0f);
+		const FVector TopRight(BoxPosition.X + BoxSize.X, BoxPosition.Y, 0.0f);
+		const FVector BottomLeft(BoxPosition.X, BoxPosition.Y + BoxSize.Y, 0.0f);
+		const FVector BottomRight(BoxPosition + BoxSize, 0.0f);
+
+		FCanvasUVTri& Upper = Triangles.AddDefaulted_GetRef();
+		Upper.V0_Pos = FVector2D(TopLeft);
+		Upper.V1_Pos = FVector2D(TopRight);
+		Upper.V2_Pos = FVector2D(BottomRight);
+		Upper.V0_UV = Upper.V1_UV = Upper.V2_UV = FVector2D::ZeroVector;
+		Upper.V0_Color = Upper.V1_Color = Upper.V2_Color = BackgroundColor;
+
+		FCanvasUVTri& Lower = Triangles.AddDefaulted_GetRef();
+		Lower.V0_Pos = FVector2D(TopLeft);
+		Lower.V1_Pos = FVector2D(BottomRight);
+		Lower.V2_Pos = FVector2D(BottomLeft);
+		Lower.V0_UV = Lower.V1_UV = Lower.V2_UV = FVector2D::ZeroVector;
+		Lower.V0_Color = Lower.V1_Color = Lower.V2_Color = BackgroundColor;
+	}
 
-			Canvas->DrawItem(Background);
-		}
+	FCanvasTriangleItem Backgrounds(Triangles, GWhiteTexture);
+	Backgrounds.BlendMode = SE_BLEND_Translucent;
+	Canvas->DrawItem(Backgrounds);
 
-		{
-			FCanvasBoxItem Border(BoxPosition, BoxSize);
-			Border.LineThickness = 1.0f;
-			Border.SetColor(FLinearColor::Gray.CopyWithNewOpacity(0.75f));
-			Canvas->DrawItem(Border);
-		}
+	FBatchedElements* Lines = Canvas->Canvas->GetBatchedElements(FCanvas::ET_Line);
+	const FHitProxyId HitProxyId = Canvas->Canvas->GetHitProxyId();
+	Lines->ReserveLines(CurrentFrameInfos.Num() * 5);
 
-		{
-			FCanvasLineItem Line(FVector2D(Info.ScreenPosition), BoxPosition);
-			Line.LineThickness = 1.0f;
-			Line.SetColor(FLinearColor::Gray.CopyWithNewOpacity(0.75f));
-			Canvas->DrawItem(Line);
-		}
+	for (const FMetaSplineDebugInfo& Info : CurrentFrameInfos)
+	{
+		const FVector2D BoxPosition = GetBoxPosition(Info);
+		const FVector2D BoxSize = Info.TextSize + LabelPadding;
+
+		const FVector TopLeft(BoxPosition, 0.0f);
+		const FVector TopRight(BoxPosition.X + BoxSize.X, BoxPosition.Y, 0.0f);
+		const FVector BottomLeft(BoxPosition.X, BoxPosition.Y + BoxSize.Y, 0.0f);
+		const FVector BottomRight(BoxPosition + BoxSize, 0.0f);
+
+		Lines->AddLine(TopLeft, TopRight, LineColor, HitProxyId);
+		Lines->AddLine(TopRight, BottomRight, LineColor, HitProxyId);
+		Lines->AddLine(BottomRight, BottomLeft, LineColor, HitProxyId);
+		Lines->AddLine(BottomLeft, TopLeft, LineColor, HitProxyId);
+		Lines->AddLine(FVector(FVector2D(Info.ScreenPosition), 0.0f), TopLeft, LineColor, HitProxyId);
+	}
 
-		{
-			FCanvasTextItem Text(DrawPosition, Info.Text, Font, FLinearColor::White);
-			Text.EnableShadow(FLinearColor::Black);
-			Canvas->DrawItem(Text);
-		}
+	FCanvasTextItem Text(FVector2D::ZeroVector, FText::GetEmpty(), GEngine->GetTinyFont(), FLinearColor::White);
+	Text.EnableShadow(FLinearColor::Black);
+	for (const FMetaSplineDebugInfo& Info : CurrentFrameInfos)
+	{
+		Text.Position = GetBoxPosition(Info) + LabelPadding * 0.5f;
+		Text.Text = Info.Text;
+		Canvas->DrawItem(Text);
 	}
 }
 
 template<typename T>
 struct FCollectInfoFromProperty
 {
-	static FText Execute(UMetaSplineMetadata& InOutMetadata, const FProperty* InProperty, int32 InIndex)
+	static void Execute(const UMetaSplineMetadata& InMetadata, const FMetaSplinePropertyLayout& InProperty, int32 InPoint, FTextBuilder& InOutBuilder)
 	{
 		FFormatOrderedArguments Args;
-		Args.Add(InProperty->GetDisplayNameText());
+		Args.Add(InProperty.Property->GetDisplayNameText());
 
-		const auto* Curve = InOutMetadata.FindCurve<T>(InProperty->GetFName());
-		if (!Curve)
+		const auto Curve = InMetadata.FindCurve<T>(InProperty.Name);
+		if (!Curve || InPoint >= Curve.Num())
 		{
-			return FText::Format(LOCTEXT("InvalidProperty", "{0}: Doesn't exist"), Args);
+			InOutBuilder.AppendLine(FText::Format(LOCTEXT("InvalidProperty", "{0}: Doesn't exist"), Args));
+			return;
 		}
-		
-		const T& Value = Curve->Points[InIndex].OutVal;
+
+		const T Value = Curve->GetValue(InPoint);
 		if constexpr (TIsFundamentalType<T>::Value)
 		{
 			Args.Add(Value);
@@ -128,31 +236,65 @@ struct FCollectInfoFromProperty
 			Args.Add(FText::FromString(Value.ToString()));
 		}
 
-		return FText::Format(LOCTEXT("FormattedDebugInfo", "{0}: {1}"), Args);
+		InOutBuilder.AppendLine(FText::Format(LOCTEXT("FormattedDebugInfo", "{0}: {1}"), Args));
 	}
 };
 
-TArray<FMetaSplineDebugInfo> FMetaSplineDebugRenderer::CollectInfosFromSpline(UCanvas* Canvas, UMetaSplineComponent* Spline)
+const FMetaSplineDebugRenderer::FLabel& FMetaSplineDebugRenderer::GetLabel(const UMetaSplineMetadata& Metadata, int32 Point)
 {
-	TArray<FMetaSplineDebugInfo> Infos;
+	FLabelCache& Cache = LabelCaches.FindOrAdd(&Metadata);
+	Cache.LastUsedFrame = GFrameCounter;
+
+	if (Cache.NumPoints != Metadata.NumPoints || Cache.ChangeCounter != Metadata.GetChangeCounter() || Cache.MetaClass != Metadata.MetaClass)
+	{
+		Cache.NumPoints = Metadata.NumPoints;
+		Cache.ChangeCounter = Metadata.GetChangeCounter();
+		Cache.MetaClass = Metadata.MetaClass;
+		Cache.Labels.Reset();
+	}
 
-	if (!Spline)
+	if (const FLabel* Label = Cache.Labels.Find(Point))
 	{
-		return Infos;
+		return *Label;
+	}
+
+	FTextBuilder Builder;
+	for (const FMetaSplinePropertyLayout& Property : FMetaSplineStructLayout::Get(Metadata.MetaClass).GetProperties())
+	{
+		if (Property.Type != EMetaSplinePropertyType::Unsupported)
+		{
+			FMetaSplineTemplateHelpers::ExecuteOnType<FCollectInfoFromProperty>(Property.Type, Metadata, Property, Point, Builder);
+		}
 	}
 
-	UMetaSplineMetadata* Metadata = Cast<UMetaSplineMetadata>(Spline->GetSplinePointsMetadata());
+	const FSlateFontInfo& FontInfo(GEngine->GetTinyFont()->GetLegacySlateFontInfo());
+
+	FLabel& Label = Cache.Labels.Add(Point);
+	Label.Text = Builder.ToText();
+	Label.Size = FontMeasure->Measure(Label.Text, FontInfo);
+	return Label;
+}
+
+void FMetaSplineDebugRenderer::CollectCandidates(const UCanvas* Canvas, const UMetaSplineComponent* Spline, int32 SplineIndex, const FVector& ViewOrigin, float MaxDistance, TArray<FCandidate>& OutCandidates)
+{
+	const UMetaSplineMetadata* Metadata = Cast<UMetaSplineMetadata>(Spline->GetSplinePointsMetadata());
 
 	if (!Metadata || !Metadata->MetaClass)
 	{
-		return Infos;
+		return;
 	}
 
 	check(Spline->GetNumberOfSplinePoints() == Metadata->NumPoints);
 
+	const float MaxDistanceSquared = FMath::Square(MaxDistance);
 	for (int32 i = 0; i < Spline->GetNumberOfSplinePoints(); i++)
 	{
 		const FVector WorldPosition = Spline->GetWorldLocationAtSplinePoint(i);
+		if (FVector::DistSquared(WorldPosition, ViewOrigin) > MaxDistanceSquared)
+		{
+			continue;
+		}
+
 		const FVector ScreenPosition = Canvas->Project(WorldPosition);
 
 		if (ScreenPosition.Z <= 0.0f || ScreenPosition.X < 0.0f || ScreenPosition.Y < 0.0f ||
@@ -161,20 +303,35 @@ TArray<FMetaSplineDebugInfo> FMetaSplineDebugRenderer::CollectInfosFromSpline(UC
 			continue;
 		}
 
-		FTextBuilder Builder;
-		for (const FProperty* Prop : TFieldRange<FProperty>(Metadata->MetaClass))
-		{
-			// It's probably not optimal to do it in this order. An optimization would be to iterate over the property in the
-			// outer loop.
-			Builder.AppendLine(
-				FMetaSplineTemplateHelpers::ExecuteOnProperty<FCollectInfoFromProperty>(Prop, *Metadata, Prop, i)
-			);
-		}
-
-		Infos.Add({ Builder.ToText(), ScreenPosition });
+		OutCandidates.Add({ ScreenPosition, SplineIndex, i });
 	}
+}
+
+#if WITH_DEV_AUTOMATION_TESTS
+#include "Misc/AutomationTest.h"
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMetaSplineDebugRendererKeepClosestTest, "MetaSpline.DebugRenderer.KeepClosest", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMetaSplineDebugRendererKeepClosestTest::RunTest(const FString& Parameters)
+{
+	const auto GetDepth = [](float Depth) { return Depth; };
+
+	TArray<float> Depths = { 5.0f, 1.0f, 10.0f, 3.0f };
+	MetaSplineDebugRenderer_Private::KeepClosest(Depths, 2, GetDepth);
+	Depths.Sort();
+	TestEqual(TEXT("Keeps the two largest depths"), Depths, TArray<float>({ 5.0f, 10.0f }));
+
+	TArray<float> Descending = { 9.0f, 7.0f, 5.0f, 3.0f, 1.0f };
+	MetaSplineDebugRenderer_Private::KeepClosest(Descending, 3, GetDepth);
+	Descending.Sort();
+	TestEqual(TEXT("Keeps the first elements when they are the closest"), Descending, TArray<float>({ 5.0f, 7.0f, 9.0f }));
+
+	TArray<float> None = { 2.0f, 4.0f };
+	MetaSplineDebugRenderer_Private::KeepClosest(None, 0, GetDepth);
+	TestEqual(TEXT("Keeps nothing"), None.Num(), 0);
 
-	return Infos;
+	return true;
 }
+#endif
 
 #undef LOCTEXT_NAMESPACE
\ No newline at end of file
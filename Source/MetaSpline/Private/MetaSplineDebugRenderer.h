@@ -3,11 +3,13 @@
 #include "CoreMinimal.h"
 
 class UCanvas;
+class UMetaSplineMetadata;
 
 struct FMetaSplineDebugInfo
 {
 	FText Text;
 	FVector ScreenPosition;
+	FVector2D TextSize;
 };
 
 class FMetaSplineDebugRenderer
@@ -18,13 +20,45 @@ public:
 private:
 	FMetaSplineDebugRenderer();
 
+	struct FLabel
+	{
+		FText Text;
+		FVector2D Size;
+	};
+
+	// The labels of the points of a spline that were drawn since the metadata last changed, by point index.
+	struct FLabelCache
+	{
+		uint32 ChangeCounter = 0;
+		const UClass* MetaClass = nullptr;
+		int32 NumPoints = 0;
+		uint64 LastUsedFrame = 0;
+
+		TMap<int32, FLabel> Labels;
+	};
+
+	// A point that may get a label, before any text work is done for it.
+	struct FCandidate
+	{
+		FVector ScreenPosition;
+		int32 Component;
+		int32 Point;
+	};
+
 	void Draw(UCanvas* Canvas, class APlayerController*);
-	TArray<FMetaSplineDebugInfo> CollectInfosFromSpline(UCanvas* Canvas, class UMetaSplineComponent* Spline);
+
+	/** Projects the points of Spline within MaxDistance that are on screen. Safe to call from any thread. */
+	static void CollectCandidates(const UCanvas* Canvas, const class UMetaSplineComponent* Spline, int32 SplineIndex, const FVector& ViewOrigin, float MaxDistance, TArray<FCandidate>& OutCandidates);
+
+	/** Returns the label of a point, which is only formatted and measured the first time it is drawn after the metadata changed. */
+	const FLabel& GetLabel(const UMetaSplineMetadata& Metadata, int32 Point);
 
 private:
 	const TSharedRef<class FSlateFontMeasure> FontMeasure;
 
+	TMap<TWeakObjectPtr<const UMetaSplineMetadata>, FLabelCache> LabelCaches;
+
 	class FDelegateHandle DelegateHandle;
 
 	friend class FMetaSplineModule;
-};
\ No newline at end of file
+};
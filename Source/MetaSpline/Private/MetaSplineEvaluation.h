@@ -0,0 +1,199 @@
+// Copyright(c) 2021 Viktor Pramberg
+#pragma once
+#include "CoreMinimal.h"
+#include "MetaSplineTrack.h"
+
+/**
+ * Evaluation of metadata curves over many keys at once.
+ */
+class FMetaSplineEvaluation
+{
+public:
+	/**
+	 * Evaluates a curve at every key in InKeys. OutValues must have the same size as InKeys.
+	 * Since metadata keys are always the point index, the segment of each key is computed directly instead of searched for,
+	 * so the keys don't need to be sorted.
+	 */
+	template<typename T, typename TView>
+	static void EvaluateBatch(const TView& InCurve, TArrayView<const float> InKeys, TArrayView<T> OutValues)
+	{
+		check(InKeys.Num() == OutValues.Num());
+
+		if (!InCurve || InCurve.Num() == 0)
+		{
+			for (T& Value : OutValues)
+			{
+				Value = T(ForceInit);
+			}
+			return;
+		}
+
+		if constexpr (TIsSame<T, float>::Value || TIsSame<T, FVector>::Value)
+		{
+			if (const auto* Track = InCurve.GetTrack())
+			{
+				EvaluateTrackBatch(*Track, InCurve.IsLooped(), InCurve.GetLoopKeyOffset(), InKeys, OutValues);
+				return;
+			}
+		}
+
+		for (int32 i = 0; i < InKeys.Num(); i++)
+		{
+			const FMetaSplineSegment Segment = FMetaSplineSegment::Find(InKeys[i], InCurve.Num(), InCurve.IsLooped(), InCurve.GetLoopKeyOffset());
+			OutValues[i] = InCurve.Eval(Segment);
+		}
+	}
+
+private:
+	// A segment reduced to what the interpolation needs. Alpha is zeroed for segments that return the first point,
+	// which makes both linear and cubic interpolation collapse to it without branching.
+	struct FResolvedSegment
+	{
+		int32 Index;
+		int32 NextIndex;
+		float Alpha;
+		float Diff;
+	};
+
+	static FResolvedSegment Resolve(float InKey, int32 InNumPoints, bool bInIsLooped, float InLoopKeyOffset, bool bInConstant)
+	{
+		const FMetaSplineSegment Segment = FMetaSplineSegment::Find(InKey, InNumPoints, bInIsLooped, InLoopKeyOffset);
+		const bool bInterpolate = Segment.Diff > 0.0f && !bInConstant;
+		return { Segment.Index, bInterpolate ? Segment.NextIndex : Segment.Index, bInterpolate ? Segment.Alpha : 0.0f, Segment.Diff };
+	}
+
+	static bool IsCubic(const EInterpCurveMode InMode)
+	{
+		return InMode != CIM_Linear && InMode != CIM_Constant;
+	}
+
+	template<typename TTrack, typename T>
+	static void EvaluateBakedBatch(const TTrack& InTrack, TArrayView<const float> InKeys, TArrayView<T> OutValues)
+	{
+		for (int32 KeyIndex = 0; KeyIndex < InKeys.Num(); KeyIndex++)
+		{
+			OutValues[KeyIndex] = TMetaSplineCurveView<const T>::EvalBaked(InTrack, InKeys[KeyIndex]);
+		}
+	}
+
+	static void EvaluateTrackBatch(const FMetaSplineFloatTrack& InTrack, bool bInIsLooped, float InLoopKeyOffset, TArrayView<const float> InKeys, TArrayView<float> OutValues)
+	{
+		if (InTrack.Baked.Num() >= 2)
+		{
+			EvaluateBakedBatch(InTrack, InKeys, OutValues);
+			return;
+		}
+
+		const float* Values = InTrack.Values.GetData();
+		const int32 NumPoints = InTrack.Values.Num();
+		const bool bConstant = InTrack.InterpMode == CIM_Constant;
+		const bool bCubic = IsCubic(InTrack.InterpMode) && InTrack.Tangents.Num() == NumPoints;
+		const float* Tangents = bCubic ? InTrack.Tangents.GetData() : nullptr;
+
+		// Four keys at a time. The values are gathered per lane, and the interpolation itself is done in vector registers.
+		const int32 NumKeys = InKeys.Num();
+		int32 KeyIndex = 0;
+		for (; KeyIndex + 4 <= NumKeys; KeyIndex += 4)
+		{
+			float Prev[4], Next[4], Alpha[4], PrevTangent[4], NextTangent[4];
+			for (int32 Lane = 0; Lane < 4; Lane++)
+			{
+				const FResolvedSegment Segment = Resolve(InKeys[KeyIndex + Lane], NumPoints, bInIsLooped, InLoopKeyOffset, bConstant);
+				Prev[Lane] = Values[Segment.Index];
+				Next[Lane] = Values[Segment.NextIndex];
+				Alpha[Lane] = Segment.Alpha;
+				if (bCubic)
+				{
+					PrevTangent[Lane] = Tangents[Segment.Index] * Segment.Diff;
+					NextTangent[Lane] = Tangents[Segment.NextIndex] * Segment.Diff;
+				}
+			}
+
+			const VectorRegister P0 = VectorLoad(Prev);
+			const VectorRegister P1 = VectorLoad(Next);
+			const VectorRegister A = VectorLoad(Alpha);
+
+			VectorRegister Result;
+			if (bCubic)
+			{
+				Result = CubicInterp(P0, VectorLoad(PrevTangent), P1, VectorLoad(NextTangent), A);
+			}
+			else
+			{
+				Result = VectorMultiplyAdd(VectorSubtract(P1, P0), A, P0);
+			}
+			VectorStore(Result, &OutValues[KeyIndex]);
+		}
+
+		for (; KeyIndex < NumKeys; KeyIndex++)
+		{
+			const FResolvedSegment Segment = Resolve(InKeys[KeyIndex], NumPoints, bInIsLooped, InLoopKeyOffset, bConstant);
+			if (bCubic)
+			{
+				OutValues[KeyIndex] = FMath::CubicInterp(Values[Segment.Index], Tangents[Segment.Index] * Segment.Diff, Values[Segment.NextIndex], Tangents[Segment.NextIndex] * Segment.Diff, Segment.Alpha);
+			}
+			else
+			{
+				OutValues[KeyIndex] = FMath::Lerp(Values[Segment.Index], Values[Segment.NextIndex], Segment.Alpha);
+			}
+		}
+	}
+
+	static void EvaluateTrackBatch(const FMetaSplineVectorTrack& InTrack, bool bInIsLooped, float InLoopKeyOffset, TArrayView<const float> InKeys, TArrayView<FVector> OutValues)
+	{
+		if (InTrack.Baked.Num() >= 2)
+		{
+			EvaluateBakedBatch(InTrack, InKeys, OutValues);
+			return;
+		}
+
+		const FVector* Values = InTrack.Values.GetData();
+		const int32 NumPoints = InTrack.Values.Num();
+		const bool bConstant = InTrack.InterpMode == CIM_Constant;
+		const bool bCubic = IsCubic(InTrack.InterpMode) && InTrack.Tangents.Num() == NumPoints;
+		const FVector* Tangents = bCubic ? InTrack.Tangents.GetData() : nullptr;
+
+		for (int32 KeyIndex = 0; KeyIndex < InKeys.Num(); KeyIndex++)
+		{
+			const FResolvedSegment Segment = Resolve(InKeys[KeyIndex], NumPoints, bInIsLooped, InLoopKeyOffset, bConstant);
+
+			const VectorRegister P0 = VectorLoadFloat3(&Values[Segment.Index]);
+			const VectorRegister P1 = VectorLoadFloat3(&Values[Segment.NextIndex]);
+			const VectorRegister A = VectorSetFloat1(Segment.Alpha);
+
+			VectorRegister Result;
+			if (bCubic)
+			{
+				const VectorRegister Diff = VectorSetFloat1(Segment.Diff);
+				const VectorRegister T0 = VectorMultiply(VectorLoadFloat3(&Tangents[Segment.Index]), Diff);
+				const VectorRegister T1 = VectorMultiply(VectorLoadFloat3(&Tangents[Segment.NextIndex]), Diff);
+				Result = CubicInterp(P0, T0, P1, T1, A);
+			}
+			else
+			{
+				Result = VectorMultiplyAdd(VectorSubtract(P1, P0), A, P0);
+			}
+			VectorStoreFloat3(Result, &OutValues[KeyIndex]);
+		}
+	}
+
+	/** Vectorized FMath::CubicInterp(). */
+	static VectorRegister CubicInterp(const VectorRegister& P0, const VectorRegister& T0, const VectorRegister& P1, const VectorRegister& T1, const VectorRegister& A)
+	{
+		const VectorRegister A2 = VectorMultiply(A, A);
+		const VectorRegister A3 = VectorMultiply(A2, A);
+		const VectorRegister Two = VectorSetFloat1(2.0f);
+		const VectorRegister Three = VectorSetFloat1(3.0f);
+
+		// Hermite basis functions
+		const VectorRegister H01 = VectorSubtract(VectorMultiply(Three, A2), VectorMultiply(Two, A3));
+		const VectorRegister H00 = VectorSubtract(VectorOne(), H01);
+		const VectorRegister H10 = VectorAdd(VectorSubtract(A3, VectorMultiply(Two, A2)), A);
+		const VectorRegister H11 = VectorSubtract(A3, A2);
+
+		VectorRegister Result = VectorMultiply(H00, P0);
+		Result = VectorMultiplyAdd(H10, T0, Result);
+		Result = VectorMultiplyAdd(H11, T1, Result);
+		return VectorMultiplyAdd(H01, P1, Result);
+	}
+};
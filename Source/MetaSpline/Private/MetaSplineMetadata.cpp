@@ -2,8 +2,63 @@
 #include "MetaSplineMetadata.h"
 #include "MetaSplineComponent.h"
 #include "MetaSplineTemplateHelpers.h"
+#include "MetaSplinePropertyLayout.h"
+#include "MetaSplineCompression.h"
+#include "MetaSplineCustomVersion.h"
+#include "MetaSplineSettings.h"
+#include "MetaSplineConstructionQueue.h"
+#include "MetaSplinePointChange.h"
 #include "MetaSpline.h"
 
+namespace MetaSplineMetadata_Private
+{
+	using FWeakSharedStorage = TWeakPtr<const FMetaSplinePackedStorage, ESPMode::ThreadSafe>;
+
+	// Every shared packed storage payload that is still in use, by content hash. Only accessed from the game thread.
+	TMultiMap<uint32, FWeakSharedStorage>& GetSharedStorageRegistry()
+	{
+		static TMultiMap<uint32, FWeakSharedStorage> Registry;
+		return Registry;
+	}
+
+	template<typename T>
+	T LerpStable(const T& A, const T& B, float Alpha)
+	{
+		return FMath::LerpStable(A, B, Alpha);
+	}
+
+	// A component wise blend of two rotations isn't a rotation.
+	FQuat LerpStable(const FQuat& A, const FQuat& B, float Alpha)
+	{
+		return FQuat::Slerp(A, B, Alpha);
+	}
+
+	// Packed tracks have a single interpolation mode for all points, and a single tangent per point.
+	template<typename T>
+	bool HasUniformInterpMode(const FInterpCurve<T>& InCurve, bool bAllowUserTangents)
+	{
+		for (const FInterpCurvePoint<T>& Point : InCurve.Points)
+		{
+			if (Point.InterpMode != InCurve.Points[0].InterpMode || Point.InterpMode == CIM_CurveBreak || (!bAllowUserTangents && Point.InterpMode == CIM_CurveUser))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	template<typename T>
+	T GetDefaultValue(const UClass* InMetaClass, FName InName)
+	{
+		const FMetaSplinePropertyLayout* Property = InMetaClass ? FMetaSplineStructLayout::Get(InMetaClass).Find(InName) : nullptr;
+		if (!Property || Property->Type != TMetaSplinePropertyType<T>::Value)
+		{
+			return T(ForceInit);
+		}
+		return Property->GetValue<T>(InMetaClass->GetDefaultObject());
+	}
+}
+
 void UMetaSplineMetadata::InsertPoint(int32 Index, float t, bool bClosedLoop)
 {
 	check(Index >= 0);
@@ -11,13 +66,9 @@ void UMetaSplineMetadata::InsertPoint(int32 Index, float t, bool bClosedLoop)
 	if (NumCurves <= 0)
 		return;
 
-	Modify();
-
-	const float InputKey = static_cast<float>(Index);
-
 	if (Index >= NumPoints)
 	{
-		AddPoint(InputKey);
+		AddPoint(static_cast<float>(Index));
 	}
 	else
 	{
@@ -26,24 +77,23 @@ void UMetaSplineMetadata::InsertPoint(int32 Index, float t, bool bClosedLoop)
 
 		TransformCurves([=](auto& Curve)
 		{
-			auto& Points = Curve.Points;
-			auto NewValue = Points[Index].OutVal;
+			auto NewValue = Curve.GetValue(Index);
 
 			if (bHasPrevIndex)
 			{
-				const auto& PrevVal = Points[PrevIndex].OutVal;
-				NewValue = FMath::LerpStable(PrevVal, NewValue, t);
+				NewValue = MetaSplineMetadata_Private::LerpStable(Curve.GetValue(PrevIndex), NewValue, t);
 			}
 
-			Points.Insert({ InputKey, NewValue }, Index);
-		});
-
-		TransformPoints(Index + 1, [](auto& Point)
-		{
-			Point.InVal += 1.0f;
+			Curve.Insert(Index, NewValue);
 		});
 
 		NumPoints++;
+		StaleKeysFrom = FMath::Min(StaleKeysFrom, Index);
+
+		ShiftDirtyPoints(Index, 1);
+		MarkPointsDirty(Index);
+
+		RecordPointChange(EMetaSplinePointChange::Insert, Index, {});
 	}
 }
 
@@ -57,18 +107,22 @@ void UMetaSplineMetadata::UpdatePoint(int32 Index, float t, bool bClosedLoop)
 	const bool bHasPrevIndex = (PrevIndex >= 0 && PrevIndex < NumPoints);
 	const bool bHasNextIndex = (NextIndex >= 0 && NextIndex < NumPoints);
 
-	Modify();
-
 	if (bHasPrevIndex && bHasNextIndex)
 	{
-		TransformCurves([=](auto& Curve)
+		FMetaSplinePointValues Before;
+		if (IsRecordingPointChanges())
 		{
-			auto& Points = Curve.Points;
-			const auto& PrevVal = Points[PrevIndex].OutVal;
-			const auto& NextVal = Points[NextIndex].OutVal;
+			CapturePoint(Index, Before);
+		}
 
-			Points[Index].OutVal = FMath::LerpStable(PrevVal, NextVal, t);
+		TransformCurves([=](auto& Curve)
+		{
+			Curve.SetValue(Index, MetaSplineMetadata_Private::LerpStable(Curve.GetValue(PrevIndex), Curve.GetValue(NextIndex), t));
 		});
+
+		MarkPointsDirty(Index);
+
+		RecordPointChange(EMetaSplinePointChange::Set, Index, MoveTemp(Before));
 	}
 }
 
@@ -77,55 +131,60 @@ void UMetaSplineMetadata::AddPoint(float InputKey)
 	if (NumCurves <= 0)
 		return;
 
-	Modify();
-
-	const int32 Index = NumPoints - 1;
-	const float NewInputKey = static_cast<float>(Index + 1);
-
-	TransformCurves([Index, NewInputKey](auto& Curve)
+	TransformCurves([this](FName Key, auto& Curve)
 	{
-		Curve.Points.Emplace(NewInputKey, Curve.Points[Index].OutVal);
+		using TUnderlyingType = typename TDecay<decltype(Curve)>::Type::ValueType;
+
+		// Splines that are generated point by point start out empty, so the first point gets the default value.
+		const int32 Index = Curve.Num();
+		if (Index > 0)
+		{
+			Curve.Insert(Index, Curve.GetValue(Index - 1));
+		}
+		else
+		{
+			Curve.Insert(Index, MetaSplineMetadata_Private::GetDefaultValue<TUnderlyingType>(MetaClass, Key));
+		}
 	});
 
 	NumPoints++;
+
+	MarkPointsDirty(NumPoints - 1);
+
+	RecordPointChange(EMetaSplinePointChange::Insert, NumPoints - 1, {});
 }
 
 void UMetaSplineMetadata::RemovePoint(int32 Index)
 {
 	check(Index < NumPoints);
 
-	Modify();
-
-	TransformCurves([Index](auto& Curve)
+	FMetaSplinePointValues Before;
+	if (IsRecordingPointChanges())
 	{
-		Curve.Points.RemoveAt(Index);
-	});
+		CapturePoint(Index, Before);
+	}
 
-	TransformPoints(Index, [](auto& Point)
-	{
-		Point.InVal -= 1.0f;
-	});
+	RemovePointValues(Index);
 
-	NumPoints--;
+	RecordPointChange(EMetaSplinePointChange::Remove, Index, MoveTemp(Before));
 }
 
 void UMetaSplineMetadata::DuplicatePoint(int32 Index)
 {
 	check(Index < NumPoints);
 
-	Modify();
-
 	TransformCurves([Index](auto& Curve)
 	{
-		Curve.Points.Insert({ Curve.Points[Index] }, Index);
-	});
-
-	TransformPoints(Index + 1, [](auto& Point)
-	{
-		Point.InVal += 1.0f;
+		Curve.Duplicate(Index);
 	});
 
 	NumPoints++;
+	StaleKeysFrom = FMath::Min(StaleKeysFrom, Index);
+
+	ShiftDirtyPoints(Index, 1);
+	MarkPointsDirty(Index, Index + 2);
+
+	RecordPointChange(EMetaSplinePointChange::Insert, Index, {});
 }
 
 void UMetaSplineMetadata::CopyPoint(const USplineMetadata* FromSplineMetadata, int32 FromIndex, int32 ToIndex)
@@ -143,26 +202,38 @@ void UMetaSplineMetadata::CopyPoint(const USplineMetadata* FromSplineMetadata, i
 			return;
 		}
 
-		Modify();
+		FMetaSplinePointValues Before;
+		if (IsRecordingPointChanges())
+		{
+			CapturePoint(ToIndex, Before);
+		}
 
 		TransformCurves([FromIndex, ToIndex, FromMetadata](FName Key, auto& Curve)
 		{
-			auto& Points = Curve.Points;
-
-			using TUnderlyingType = TCurveUnderlyingType<decltype(Curve)>::Type;
-			Points[ToIndex].OutVal = FromMetadata->FindCurve<TUnderlyingType>(Key)->Points[FromIndex].OutVal;
+			using TUnderlyingType = typename TDecay<decltype(Curve)>::Type::ValueType;
+			if (const auto FromCurve = FromMetadata->FindCurve<TUnderlyingType>(Key))
+			{
+				Curve.SetValue(ToIndex, FromCurve->GetValue(FromIndex));
+			}
 		});
+
+		MarkPointsDirty(ToIndex);
+
+		RecordPointChange(EMetaSplinePointChange::Set, ToIndex, MoveTemp(Before));
 	}
 }
 
 void UMetaSplineMetadata::Reset(int32 InNumPoints)
 {
 	Modify();
-	NumPoints = InNumPoints;
 
-	TransformCurves([this](auto& Curve)
+	// The spline adds the points one at a time after a reset, so the count is only used to reserve memory.
+	NumPoints = 0;
+	MarkAllPointsDirty();
+
+	TransformCurves([InNumPoints](auto& Curve)
 	{
-		Curve.Points.Reset(NumPoints);
+		Curve.Reset(InNumPoints);
 	});
 }
 
@@ -171,87 +242,1242 @@ void UMetaSplineMetadata::Fixup(int32 InNumPoints, USplineComponent* SplineComp)
 	const UMetaSplineComponent* MetaSpline = Cast<UMetaSplineComponent>(SplineComp);
 	UpdateMetadataClass(MetaSpline ? MetaSpline->MetadataClass : nullptr);
 
-	TransformPoints([](auto& Point, int32 Index)
-	{
-		Point.InVal = static_cast<float>(Index);
-	});
+	RenumberStaleKeys();
 
+	// Check the sizes first, so shared storage is only copied if it actually has to be resized.
 	NumCurves = 0;
-	TransformCurves([&](FName Key, auto& Curve)
+	bool bNeedsResize = false;
+	AsConst(*this).TransformCurves([&](const auto& Curve)
 	{
 		NumCurves++;
-		auto& Points = Curve.Points;
+		bNeedsResize |= MetaClass ? Curve.Num() != InNumPoints : Curve.Num() > InNumPoints;
+	});
 
-		if (!MetaClass)
-			return;
+	if (bNeedsResize)
+	{
+		TransformCurves([&](FName Key, auto& Curve)
+		{
+			using TUnderlyingType = typename TDecay<decltype(Curve)>::Type::ValueType;
+
+			if (!MetaClass)
+			{
+				Curve.SetNum(FMath::Min(Curve.Num(), InNumPoints), TUnderlyingType(ForceInit));
+				return;
+			}
+
+			Curve.SetNum(InNumPoints, MetaSplineMetadata_Private::GetDefaultValue<TUnderlyingType>(MetaClass, Key));
+		});
+	}
+
+	if (NumPoints != InNumPoints)
+	{
+		MarkAllPointsDirty();
+	}
+	NumPoints = InNumPoints;
+
+#if WITH_EDITOR
+	UpdateTrackSettings();
+#endif
+}
 
-		while (Points.Num() < InNumPoints)
+template<typename T>
+struct FAddCurve
+{
+	static void Execute(UMetaSplineMetadata& InOutMetadata, const FMetaSplinePropertyLayout& InProperty, UMetaSplineMetadata::FMigratedCurves& InOutPrevious)
+	{
+		if (InOutMetadata.ReclaimCurve<T>(InProperty.Name, InOutPrevious))
 		{
-			const float InVal = Points.Num() > 0 ? Points[Points.Num() - 1].InVal + 1.0f : 0.0f;
+			return;
+		}
+
+		const T& Value = InProperty.GetValue<T>(InOutMetadata.MetaClass->GetDefaultObject());
+		InOutMetadata.AddCurve<T>(InProperty.Name, Value);
+	}
+};
 
-			using TUnderlyingType = TCurveUnderlyingType<decltype(Curve)>::Type;
+bool UMetaSplineMetadata::MatchesLayout(const UClass* InClass) const
+{
+	if (!InClass)
+	{
+		int32 NumExisting = 0;
+		TransformCurves([&NumExisting](const auto&) { NumExisting++; });
+		return NumExisting == 0;
+	}
 
-			const FProperty* Property = MetaClass->FindPropertyByName(Key);
-			Points.Add({ InVal, *Property->ContainerPtrToValuePtr<TUnderlyingType>(MetaClass->GetDefaultObject()) });
+	int32 NumProperties = 0;
+	bool bMatches = true;
+	for (const FMetaSplinePropertyLayout& Property : FMetaSplineStructLayout::Get(InClass).GetProperties())
+	{
+		if (Property.Type == EMetaSplinePropertyType::Unsupported)
+		{
+			continue;
 		}
+
+		NumProperties++;
+		ForEachMetaSplineType([this, &Property, &bMatches](auto Tag)
+		{
+			using T = typename decltype(Tag)::Type;
+			if (Property.Type != TMetaSplinePropertyType<T>::Value)
+			{
+				return;
+			}
+
+			// Packed tracks also have to be in the slot property handles resolve to.
+			if (Storage == EMetaSplineMetadataStorage::Packed)
+			{
+				const auto& Tracks = GetPacked().GetTracks<T>();
+				bMatches &= Tracks.IsValidIndex(Property.Slot) && Tracks[Property.Slot].Name == Property.Name;
+			}
+			else
+			{
+				bMatches &= FindCurveMapForType<T>().Contains(Property.Name);
+			}
+		});
+	}
+
+	int32 NumExisting = 0;
+	TransformCurves([&NumExisting](const auto&) { NumExisting++; });
+	return bMatches && NumExisting == NumProperties;
+}
+
+void UMetaSplineMetadata::UpdateMetadataClass(UClass* InClass)
+{
+	// Recompiling a Blueprint changes the properties of its class in place, so the curves are compared with the layout of the
+	// class rather than just the class pointer.
+	if (MetaClass == InClass && MatchesLayout(InClass))
+	{
+		return;
+	}
+
+	// Only the containers are moved out here, not the curves themselves. Curves of properties with the same name and
+	// type in the new class are moved back, and whatever is left in Previous belongs to removed properties.
+	FMigratedCurves Previous;
+	ForEachMetaSplineType([this, &Previous](auto Tag)
+	{
+		using T = typename decltype(Tag)::Type;
+		Swap(Previous.Packed.GetTracks<T>(), GetMutablePacked().GetTracks<T>());
+		Swap(FindCurveMapForType_Implementation<T>(&Previous), FindCurveMapForType<T>());
 	});
 
-	TransformCurves([=](auto& Curve)
+	NumCurves = 0;
+	MarkAllPointsDirty();
+
+	MetaClass = InClass;
+
+	if (!MetaClass)
+		return;
+
+	for (const FMetaSplinePropertyLayout& Property : FMetaSplineStructLayout::Get(MetaClass).GetProperties())
 	{
-		auto& Points = Curve.Points;
-		if (Points.Num() > InNumPoints)
+		if (Property.Type != EMetaSplinePropertyType::Unsupported)
 		{
-			Points.RemoveAt(InNumPoints, Points.Num() - InNumPoints);
+			FMetaSplineTemplateHelpers::ExecuteOnType<FAddCurve>(Property.Type, *this, Property, Previous);
 		}
-	});
+	}
+}
 
-	NumPoints = InNumPoints;
+template<typename T>
+bool UMetaSplineMetadata::ReclaimCurve(FName InName, FMigratedCurves& InOutPrevious)
+{
+	if (Storage == EMetaSplineMetadataStorage::Packed)
+	{
+		// Tracks are in meta class order, so unless properties were reordered the track is at the slot it is moved to.
+		auto& Tracks = GetMutablePacked().GetTracks<T>();
+		auto& PreviousTracks = InOutPrevious.Packed.GetTracks<T>();
+		const int32 Slot = Tracks.Num();
+		auto* Track = (PreviousTracks.IsValidIndex(Slot) && PreviousTracks[Slot].Name == InName) ? &PreviousTracks[Slot] : InOutPrevious.Packed.FindTrack<T>(InName);
+		if (!Track)
+		{
+			return false;
+		}
+
+		Tracks.Add(MoveTemp(*Track));
+		Track->Name = NAME_None;
+	}
+	else
+	{
+		auto* Curve = FindCurveMapForType_Implementation<T>(&InOutPrevious).Find(InName);
+		if (!Curve)
+		{
+			return false;
+		}
+
+		FindCurveMapForType<T>().Add(InName, MoveTemp(*Curve));
+	}
+
+	NumCurves++;
+	return true;
 }
 
 template<typename T>
-struct FAddCurve
+void UMetaSplineMetadata::AddCurve(FName InName, const T& InDefaultValue)
+{
+	if (Storage == EMetaSplineMetadataStorage::Packed)
+	{
+		auto& Track = GetMutablePacked().GetTracks<T>().AddDefaulted_GetRef();
+		Track.Name = InName;
+		Track.Values.Init(InDefaultValue, NumPoints);
+	}
+	else
+	{
+		auto& Curve = FindCurveMapForType<T>().Add(InName, {});
+		Curve.Points.Reserve(NumPoints);
+		for (int32 i = 0; i < NumPoints; i++)
+		{
+			Curve.AddPoint(i, InDefaultValue);
+		}
+	}
+
+	NumCurves++;
+}
+
+template<typename T>
+void UMetaSplineMetadata::MoveCurvesToTracks()
 {
-	static void Execute(UMetaSplineMetadata& InOutMetadata, const FProperty* InProperty)
+	FMetaSplinePackedStorage& PackedStorage = GetMutablePacked();
+	auto& Curves = FindCurveMapForType<T>();
+	auto& Tracks = PackedStorage.GetTracks<T>();
+	Tracks.Reset(Curves.Num());
+
+	// Lay out the tracks in meta class order, so property handles resolved from the class can index them directly.
+	TArray<FName> Names;
+	Names.Reserve(Curves.Num());
+	if (MetaClass)
+	{
+		for (const FMetaSplinePropertyLayout& Property : FMetaSplineStructLayout::Get(MetaClass).GetProperties())
+		{
+			if (Curves.Contains(Property.Name))
+			{
+				Names.Add(Property.Name);
+			}
+		}
+	}
+	for (const auto& Curve : Curves)
+	{
+		Names.AddUnique(Curve.Key);
+	}
+
+	for (const FName Name : Names)
 	{
-		auto& Map = InOutMetadata.FindCurveMapForType<T>();
-		auto& Curve = Map.Add(InProperty->GetFName(), {});
+		const auto& Curve = Curves.FindChecked(Name);
+		const auto& Points = Curve.Points;
+
+		auto& Track = Tracks.AddDefaulted_GetRef();
+		Track.Name = Name;
+		Track.InterpMode = Points.Num() > 0 ? Points[0].InterpMode : TEnumAsByte<EInterpCurveMode>(CIM_Linear);
 
-		const T& Value = *InProperty->ContainerPtrToValuePtr<T>(InOutMetadata.MetaClass->GetDefaultObject());
-		for (int32 i = 0; i < InOutMetadata.NumPoints; i++)
+		Track.Values.SetNumUninitialized(Points.Num());
+		for (int32 i = 0; i < Points.Num(); i++)
 		{
-			Curve.AddPoint(i, Value);
+			Track.Values[i] = Points[i].OutVal;
 		}
 
-		InOutMetadata.NumCurves++;
+		PackedStorage.bIsLooped = Curve.bIsLooped;
+		PackedStorage.LoopKeyOffset = Curve.LoopKeyOffset;
 	}
-};
 
-void UMetaSplineMetadata::UpdateMetadataClass(UClass* InClass)
+	Curves.Empty();
+}
+
+template<typename T>
+void UMetaSplineMetadata::MoveTracksToCurves()
+{
+	FMetaSplinePackedStorage& PackedStorage = GetMutablePacked();
+	auto& Curves = FindCurveMapForType<T>();
+	auto& Tracks = PackedStorage.GetTracks<T>();
+	Curves.Empty(Tracks.Num());
+
+	for (auto& Track : Tracks)
+	{
+		auto& Curve = Curves.Add(Track.Name, {});
+		Curve.bIsLooped = PackedStorage.bIsLooped;
+		Curve.LoopKeyOffset = PackedStorage.LoopKeyOffset;
+
+		auto& Points = Curve.Points;
+		Points.Reserve(Track.Values.Num());
+		for (int32 i = 0; i < Track.Values.Num(); i++)
+		{
+			auto& Point = Points.Emplace_GetRef(static_cast<float>(i), Track.Values[i]);
+			Point.InterpMode = Track.InterpMode;
+		}
+	}
+
+	Tracks.Empty();
+}
+
+bool UMetaSplineMetadata::CanPackCurveMaps() const
+{
+	// Packed tracks compute their own tangents, so curves with user tangents would be converted lossily.
+	FName UnpackableCurve = NAME_None;
+	ForEachMetaSplineType([this, &UnpackableCurve](auto Tag)
+	{
+		using T = typename decltype(Tag)::Type;
+		for (const auto& Curve : FindCurveMapForType<T>())
+		{
+			if (UnpackableCurve.IsNone() && !MetaSplineMetadata_Private::HasUniformInterpMode(Curve.Value, false))
+			{
+				UnpackableCurve = Curve.Key;
+			}
+		}
+	});
+
+	if (UnpackableCurve.IsNone())
+	{
+		return true;
+	}
+
+	if (!bWarnedUnpackableCurves)
+	{
+		UE_LOG(LogMetaSpline, Warning, TEXT("%s keeps curve storage, since %s has per point interpolation modes or user tangents."), *GetPathName(), *UnpackableCurve.ToString());
+		bWarnedUnpackableCurves = true;
+	}
+	return false;
+}
+
+void UMetaSplineMetadata::SetStorage(EMetaSplineMetadataStorage InStorage)
 {
-	if (MetaClass == InClass)
+	if (Storage == InStorage)
 	{
 		return;
 	}
 
-	// #TODO: More sophisticated cleanup that only updates relevant properties instead of resetting everything.
-	FloatCurves.Empty();
-	VectorCurves.Empty();
+	if (InStorage == EMetaSplineMetadataStorage::Packed && !CanPackCurveMaps())
+	{
+		return;
+	}
 
-	MetaClass = InClass;
+	Modify();
 
-	if (!MetaClass)
+	ForEachMetaSplineType([this, InStorage](auto Tag)
+	{
+		using T = typename decltype(Tag)::Type;
+		if (InStorage == EMetaSplineMetadataStorage::Packed)
+		{
+			MoveCurvesToTracks<T>();
+		}
+		else
+		{
+			MoveTracksToCurves<T>();
+		}
+	});
+
+	Storage = InStorage;
+
+	// Tangents are not carried over between storages.
+	MarkAllPointsDirty();
+	const USplineComponent* SplineComp = GetTypedOuter<USplineComponent>();
+	AutoSetTangents(0.0f, SplineComp ? SplineComp->bStationaryEndpoints : false);
+}
+
+void UMetaSplineMetadata::SetLoopKey(float InLoopKey)
+{
+	if (Storage == EMetaSplineMetadataStorage::Packed)
+	{
+		// Same rules as FInterpCurve::SetLoopKey(), where the last key is always the last point index.
+		const float LastKey = static_cast<float>(NumPoints - 1);
+		if (NumPoints > 0 && InLoopKey > LastKey)
+		{
+			SetPackedLoopState(true, InLoopKey - LastKey);
+		}
+		else
+		{
+			SetPackedLoopState(false, 0.0f);
+		}
 		return;
+	}
+
+	SetPackedLoopState(false, 0.0f);
+
+	TransformCurves([InLoopKey](auto& Curve)
+	{
+		Curve.GetCurve()->SetLoopKey(InLoopKey);
+	});
+}
+
+void UMetaSplineMetadata::ClearLoopKey()
+{
+	SetPackedLoopState(false, 0.0f);
+
+	if (Storage == EMetaSplineMetadataStorage::Curves)
+	{
+		TransformCurves([](auto& Curve)
+		{
+			Curve.GetCurve()->ClearLoopKey();
+		});
+	}
+}
 
-	for (FProperty* Property : TFieldRange<FProperty>(MetaClass))
+void UMetaSplineMetadata::SetPackedLoopState(bool bInIsLooped, float InLoopKeyOffset)
+{
+	const FMetaSplinePackedStorage& Current = GetPacked();
+	if (Current.bIsLooped != bInIsLooped || Current.LoopKeyOffset != InLoopKeyOffset)
 	{
-		FMetaSplineTemplateHelpers::ExecuteOnProperty<FAddCurve>(Property, *this, Property);
+		FMetaSplinePackedStorage& Mutable = GetMutablePacked();
+		Mutable.bIsLooped = bInIsLooped;
+		Mutable.LoopKeyOffset = InLoopKeyOffset;
 	}
 }
 
-void UMetaSplineMetadata::PostTransacted(const FTransactionObjectEvent& TransactionEvent)
+FMetaSplinePackedStorage& UMetaSplineMetadata::GetMutablePacked()
 {
-	Super::PostTransacted(TransactionEvent);
+	if (SharedPacked.IsValid())
+	{
+		Packed = *SharedPacked;
+		SharedPacked.Reset();
+	}
+	return Packed;
+}
+
+bool UMetaSplineMetadata::CopyMetadataFrom(const UMetaSplineMetadata& InOther)
+{
+	if (&InOther == this)
+	{
+		return false;
+	}
+
+	// Curve storage is only kept for compatibility, so it is always copied.
+	const bool bSameLayout = Storage == InOther.Storage && MetaClass == InOther.MetaClass && NumPoints == InOther.NumPoints;
+	const bool bSamePayload = SharedPacked.IsValid() && SharedPacked == InOther.SharedPacked;
+	if (bSameLayout && Storage == EMetaSplineMetadataStorage::Packed && (bSamePayload || GetPacked().HasSameContent(InOther.GetPacked())))
+	{
+		return false;
+	}
+
+	Modify();
+
+	Storage = InOther.Storage;
+	MetaClass = InOther.MetaClass;
+
+	ForEachMetaSplineType([this, &InOther](auto Tag)
+	{
+		using T = typename decltype(Tag)::Type;
+		FindCurveMapForType<T>() = InOther.FindCurveMapForType<T>();
+	});
+
+	++ChangeCounter;
+	if (InOther.SharedPacked.IsValid())
+	{
+		SharedPacked = InOther.SharedPacked;
+		Packed = FMetaSplinePackedStorage();
+	}
+	else
+	{
+		SharedPacked.Reset();
+		Packed = InOther.Packed;
+	}
+
+	// The tangents were copied as well, so only what was waiting to be recomputed in the other metadata needs recomputing here.
+	NumCurves = InOther.NumCurves;
+	NumPoints = InOther.NumPoints;
+	TangentSettings = InOther.TangentSettings;
+	DirtyBegin = InOther.DirtyBegin;
+	DirtyEnd = InOther.DirtyEnd;
+	bAllPointsDirty = InOther.bAllPointsDirty;
+	StaleKeysFrom = InOther.StaleKeysFrom;
+
+	return true;
+}
+
+void UMetaSplineMetadata::ShareStorage()
+{
+	if (!IsInGameThread() || SharedPacked.IsValid() || Storage != EMetaSplineMetadataStorage::Packed || !GetDefault<UMetaSplineSettings>()->bShareIdenticalMetadata)
+	{
+		return;
+	}
+
+	using namespace MetaSplineMetadata_Private;
+	TMultiMap<uint32, FWeakSharedStorage>& Registry = GetSharedStorageRegistry();
+
+	const uint32 Hash = Packed.GetContentHash();
+	for (auto It = Registry.CreateKeyIterator(Hash); It; ++It)
+	{
+		TSharedPtr<const FMetaSplinePackedStorage, ESPMode::ThreadSafe> Existing = It.Value().Pin();
+		if (!Existing.IsValid())
+		{
+			It.RemoveCurrent();
+		}
+		else if (Existing->HasSameContent(Packed))
+		{
+			SharedPacked = MoveTemp(Existing);
+			Packed = FMetaSplinePackedStorage();
+			return;
+		}
+	}
+
+	SharedPacked = MakeShared<FMetaSplinePackedStorage, ESPMode::ThreadSafe>(MoveTemp(Packed));
+	Packed = FMetaSplinePackedStorage();
+	Registry.Add(Hash, SharedPacked);
+
+	// Payloads are released by their last user without touching the registry, so sweep it whenever it has doubled in size.
+	static int32 SweepThreshold = 1024;
+	if (Registry.Num() > SweepThreshold)
+	{
+		for (auto It = Registry.CreateIterator(); It; ++It)
+		{
+			if (!It.Value().IsValid())
+			{
+				It.RemoveCurrent();
+			}
+		}
+		SweepThreshold = FMath::Max(1024, Registry.Num() * 2);
+	}
+}
+
+TSharedRef<const FMetaSplinePackedStorage, ESPMode::ThreadSafe> UMetaSplineMetadata::MakeImmutableStorage() const
+{
+	if (SharedPacked.IsValid())
+	{
+		return SharedPacked.ToSharedRef();
+	}
+
+	if (Storage == EMetaSplineMetadataStorage::Packed)
+	{
+		return MakeShared<FMetaSplinePackedStorage, ESPMode::ThreadSafe>(Packed);
+	}
+
+	TSharedRef<FMetaSplinePackedStorage, ESPMode::ThreadSafe> Result = MakeShared<FMetaSplinePackedStorage, ESPMode::ThreadSafe>();
+	GetLoopState(Result->bIsLooped, Result->LoopKeyOffset);
+	TransformCurves([this, &Result](FName Key, const auto& Curve)
+	{
+		using T = typename TDecay<decltype(Curve)>::Type::ValueType;
+
+		// User tangents are copied as is, but a track can't change interpolation mode between points.
+		if (!bWarnedUnpackableCurves && !MetaSplineMetadata_Private::HasUniformInterpMode(*Curve.GetCurve(), true))
+		{
+			UE_LOG(LogMetaSpline, Warning, TEXT("%s: Snapshots of %s use the interpolation mode of its first point for all points."), *GetPathName(), *Key.ToString());
+			bWarnedUnpackableCurves = true;
+		}
+
+		auto& Track = Result->GetTracks<T>().AddDefaulted_GetRef();
+		Track.Name = Key;
+		Track.InterpMode = Curve.Num() > 0 ? Curve.GetInterpMode(0) : CIM_Linear;
+		Track.Values.SetNumUninitialized(Curve.Num());
+		Track.Tangents.SetNumUninitialized(Curve.Num());
+		for (int32 i = 0; i < Curve.Num(); i++)
+		{
+			Track.Values[i] = Curve.GetValue(i);
+			Track.Tangents[i] = Curve.GetLeaveTangent(i);
+		}
+	});
+	return Result;
+}
+
+void UMetaSplineMetadata::AutoSetTangents(float InTension, bool bStationaryEndpoints)
+{
+	const FTangentSettings Settings { IsLooped(), GetLoopKeyOffset(), InTension, bStationaryEndpoints };
+	if (!TangentSettings.IsSet() || !(TangentSettings.GetValue() == Settings))
+	{
+		TangentSettings = Settings;
+		bAllPointsDirty = true;
+	}
+
+	if (!bAllPointsDirty && DirtyBegin >= DirtyEnd)
+	{
+		return;
+	}
+
+	// FInterpCurve::AutoSetTangents() reads the input keys.
+	RenumberStaleKeys();
+
+	// A tangent depends on the previous and next point, so the neighbours of the modified points need updating too.
+	// On a loop, the first and last points are neighbours as well.
+	const int32 Begin = bAllPointsDirty ? 0 : DirtyBegin - 1;
+	const int32 End = bAllPointsDirty ? NumPoints : DirtyEnd + 1;
+	const bool bUpdateFirst = Settings.bIsLooped && End > NumPoints;
+	const bool bUpdateLast = Settings.bIsLooped && Begin < 0;
+
+	TransformCurves([&](auto& Curve)
+	{
+		Curve.AutoSetTangents(InTension, bStationaryEndpoints, Begin, End);
+
+		if (bUpdateFirst)
+		{
+			Curve.AutoSetTangents(InTension, bStationaryEndpoints, 0, 1);
+		}
+		if (bUpdateLast)
+		{
+			Curve.AutoSetTangents(InTension, bStationaryEndpoints, NumPoints - 1, NumPoints);
+		}
+	});
+
+	bAllPointsDirty = false;
+	DirtyBegin = DirtyEnd = 0;
+}
+
+void UMetaSplineMetadata::RenumberStaleKeys()
+{
+	if (StaleKeysFrom == TNumericLimits<int32>::Max())
+	{
+		return;
+	}
+
+	// Packed tracks don't store input keys, they are always the point index.
+	if (Storage == EMetaSplineMetadataStorage::Curves)
+	{
+		TransformCurves([this](auto& Curve)
+		{
+			Curve.RenumberKeys(StaleKeysFrom);
+		});
+	}
+
+	StaleKeysFrom = TNumericLimits<int32>::Max();
+}
+
+void UMetaSplineMetadata::SaveCleanState(uint32 InStateHash, int32 InNumPoints, float InTension, bool bStationaryEndpoints)
+{
+	const FTangentSettings Settings { IsLooped(), GetLoopKeyOffset(), InTension, bStationaryEndpoints };
+	const bool bIsClean = NumPoints == InNumPoints && !bAllPointsDirty && DirtyBegin >= DirtyEnd && StaleKeysFrom == TNumericLimits<int32>::Max() &&
+		TangentSettings.IsSet() && TangentSettings.GetValue() == Settings;
+
+	CleanStateHash = bIsClean ? InStateHash : 0;
+}
+
+bool UMetaSplineMetadata::RestoreCleanState(uint32 InStateHash, int32 InNumPoints, float InTension, bool bStationaryEndpoints)
+{
+	if (CleanStateHash == 0 || CleanStateHash != InStateHash)
+	{
+		return false;
+	}
+
+	int32 NumLoadedCurves = 0;
+	bool bIsValid = true;
+	AsConst(*this).TransformCurves([InNumPoints, &NumLoadedCurves, &bIsValid](const auto& Curve)
+	{
+		NumLoadedCurves++;
+		bIsValid &= Curve.Num() == InNumPoints;
+
+		// Tangents aren't stored for compressed tracks, so those have to be recomputed.
+		if (const auto* Track = Curve.GetTrack())
+		{
+			const bool bHasTangents = Track->InterpMode == CIM_CurveAuto || Track->InterpMode == CIM_CurveAutoClamped;
+			bIsValid &= !bHasTangents || Track->Tangents.Num() == InNumPoints;
+		}
+	});
+
+	if (!bIsValid)
+	{
+		return false;
+	}
+
+	NumCurves = NumLoadedCurves;
+	NumPoints = InNumPoints;
+	StaleKeysFrom = TNumericLimits<int32>::Max();
+	TangentSettings = FTangentSettings { IsLooped(), GetLoopKeyOffset(), InTension, bStationaryEndpoints };
+	bAllPointsDirty = false;
+	DirtyBegin = DirtyEnd = 0;
+
+#if WITH_EDITOR
+	// A changed interpolation mode invalidates the saved tangents.
+	UpdateTrackSettings();
+	if (bAllPointsDirty)
+	{
+		return false;
+	}
+#endif
+
+	return true;
+}
+
+void UMetaSplineMetadata::MarkPointsDirty(int32 InBegin, int32 InEnd)
+{
+	++ChangeCounter;
+
+	InBegin = FMath::Max(InBegin, 0);
+	InEnd = FMath::Min(InEnd, NumPoints);
+	if (InBegin >= InEnd)
+	{
+		return;
+	}
+
+	if (DirtyBegin >= DirtyEnd)
+	{
+		DirtyBegin = InBegin;
+		DirtyEnd = InEnd;
+	}
+	else
+	{
+		DirtyBegin = FMath::Min(DirtyBegin, InBegin);
+		DirtyEnd = FMath::Max(DirtyEnd, InEnd);
+	}
+}
+
+void UMetaSplineMetadata::ShiftDirtyPoints(int32 InIndex, int32 InDelta)
+{
+	if (DirtyBegin >= DirtyEnd)
+	{
+		return;
+	}
+
+	if (DirtyBegin > InIndex)
+	{
+		DirtyBegin = FMath::Max(DirtyBegin + InDelta, InIndex);
+	}
+	if (DirtyEnd > InIndex)
+	{
+		DirtyEnd = FMath::Max(DirtyEnd + InDelta, InIndex);
+	}
+}
+
+FMetaSplinePropertyHandle UMetaSplineMetadata::MakePropertyHandle(const UClass* InMetaClass, FName InProperty)
+{
+	FMetaSplinePropertyHandle Handle;
+	Handle.PropertyName = InProperty;
+
+	// Tracks are laid out in field order per type, which is the slot the layout resolves.
+	if (const FMetaSplinePropertyLayout* Property = FMetaSplineStructLayout::Get(InMetaClass).Find(InProperty))
+	{
+		Handle.Slot = Property->Slot;
+	}
+
+	return Handle;
+}
+
+FMetaSplineSegment UMetaSplineMetadata::FindSegment(float InKey) const
+{
+	return FMetaSplineSegment::Find(InKey, NumPoints, IsLooped(), GetLoopKeyOffset());
+}
+
+bool UMetaSplineMetadata::IsLooped() const
+{
+	bool bIsLooped = false;
+	float LoopKeyOffset = 0.0f;
+	GetLoopState(bIsLooped, LoopKeyOffset);
+	return bIsLooped;
+}
+
+float UMetaSplineMetadata::GetLoopKeyOffset() const
+{
+	bool bIsLooped = false;
+	float LoopKeyOffset = 0.0f;
+	GetLoopState(bIsLooped, LoopKeyOffset);
+	return LoopKeyOffset;
+}
+
+void UMetaSplineMetadata::GetLoopState(bool& bOutIsLooped, float& OutLoopKeyOffset) const
+{
+	if (Storage == EMetaSplineMetadataStorage::Packed)
+	{
+		bOutIsLooped = GetPacked().bIsLooped;
+		OutLoopKeyOffset = GetPacked().LoopKeyOffset;
+		return;
+	}
+
+	// All curves share the same loop state, so any of them will do.
+	bool bFound = false;
+	ForEachMetaSplineType([&](auto Tag)
+	{
+		for (const auto& Curve : FindCurveMapForType<typename decltype(Tag)::Type>())
+		{
+			if (!bFound)
+			{
+				bOutIsLooped = Curve.Value.bIsLooped;
+				OutLoopKeyOffset = Curve.Value.LoopKeyOffset;
+				bFound = true;
+			}
+			break;
+		}
+	});
+}
+
+template<typename T>
+void UMetaSplineMetadata::EvaluatePropertyAtSegment(const FMetaSplinePropertyLayout& InProperty, const FMetaSplineSegment& InSegment, float InKey, int32& InOutSlot, void* OutContainer) const
+{
+	const FName Name = InProperty.Name;
+
+	// Containers usually have the same property order as the meta class, so try the next track before searching.
+	TMetaSplineCurveView<const T> Curve;
+	if (Storage == EMetaSplineMetadataStorage::Packed)
+	{
+		const FMetaSplinePackedStorage& PackedStorage = GetPacked();
+		const auto& Tracks = PackedStorage.GetTracks<T>();
+		const auto* Track = (Tracks.IsValidIndex(InOutSlot) && Tracks[InOutSlot].Name == Name) ? &Tracks[InOutSlot] : PackedStorage.FindTrack<T>(Name);
+		if (Track)
+		{
+			InOutSlot = static_cast<int32>(Track - Tracks.GetData()) + 1;
+			Curve = { Track, &PackedStorage };
+		}
+	}
+	else
+	{
+		Curve = FindCurve<T>(Name);
+	}
+
+	if (Curve)
+	{
+		InProperty.GetValue<T>(OutContainer) = Curve.Num() == NumPoints ? Curve.Eval(InSegment) : Curve.Eval(InKey);
+	}
+}
+
+bool UMetaSplineMetadata::EvaluateAllAtKey(float InKey, const UStruct* InContainerType, void* OutContainer) const
+{
+	if (!InContainerType || !OutContainer || NumPoints <= 0)
+	{
+		return false;
+	}
+
+	const FMetaSplineSegment Segment = FindSegment(InKey);
+
+	int32 Slots[static_cast<int32>(EMetaSplinePropertyType::Num)] = {};
+	for (const FMetaSplinePropertyLayout& Property : FMetaSplineStructLayout::Get(InContainerType).GetProperties())
+	{
+		switch (Property.Type)
+		{
+		case EMetaSplinePropertyType::Float:
+			EvaluatePropertyAtSegment<float>(Property, Segment, InKey, Slots[static_cast<int32>(Property.Type)], OutContainer);
+			break;
+		case EMetaSplinePropertyType::Vector:
+			EvaluatePropertyAtSegment<FVector>(Property, Segment, InKey, Slots[static_cast<int32>(Property.Type)], OutContainer);
+			break;
+		case EMetaSplinePropertyType::Quat:
+			EvaluatePropertyAtSegment<FQuat>(Property, Segment, InKey, Slots[static_cast<int32>(Property.Type)], OutContainer);
+			break;
+		case EMetaSplinePropertyType::LinearColor:
+			EvaluatePropertyAtSegment<FLinearColor>(Property, Segment, InKey, Slots[static_cast<int32>(Property.Type)], OutContainer);
+			break;
+		case EMetaSplinePropertyType::Vector2D:
+			EvaluatePropertyAtSegment<FVector2D>(Property, Segment, InKey, Slots[static_cast<int32>(Property.Type)], OutContainer);
+			break;
+		default:
+			break;
+		}
+	}
+
+	return true;
+}
+
+#if WITH_EDITOR
+void UMetaSplineMetadata::UpdateTrackSettings()
+{
+	if (!MetaClass || Storage != EMetaSplineMetadataStorage::Packed)
+	{
+		return;
+	}
+
+	const FMetaSplineStructLayout& Layout = FMetaSplineStructLayout::Get(MetaClass);
+	const auto GetSettings = [&Layout](FName Key, EInterpCurveMode& InOutInterpMode, int32& OutBakeSamples, EMetaSplineCompression& OutCompression)
+	{
+		const FMetaSplinePropertyLayout* Property = Layout.Find(Key);
+		if (!Property)
+		{
+			return false;
+		}
+
+		// Packed tracks compute their own tangents, so only the modes that don't need user tangents are accepted.
+		// Without the tag, the track keeps the mode it was created or converted with.
+		static const FName InterpModeName(TEXT("MetaSplineInterpMode"));
+		if (Property->Property->HasMetaData(InterpModeName))
+		{
+			const FString& InterpMode = Property->Property->GetMetaData(InterpModeName);
+			InOutInterpMode = InterpMode == TEXT("Constant") ? CIM_Constant :
+				InterpMode == TEXT("CurveAuto") ? CIM_CurveAuto :
+				InterpMode == TEXT("CurveAutoClamped") ? CIM_CurveAutoClamped : CIM_Linear;
+		}
+
+		static const FName BakeSamplesName(TEXT("MetaSplineBakeSamples"));
+		OutBakeSamples = Property->Property->HasMetaData(BakeSamplesName) ? Property->Property->GetINTMetaData(BakeSamplesName) : 0;
+
+		static const FName CompressionName(TEXT("MetaSplineCompression"));
+		const int64 Compression = Property->Property->HasMetaData(CompressionName) ? StaticEnum<EMetaSplineCompression>()->GetValueByNameString(Property->Property->GetMetaData(CompressionName)) : INDEX_NONE;
+		OutCompression = Compression != INDEX_NONE ? static_cast<EMetaSplineCompression>(Compression) : EMetaSplineCompression::None;
+		return true;
+	};
+
+	// Only write the settings if they changed, so shared storage isn't copied.
+	bool bChanged = false;
+	bool bInterpModeChanged = false;
+	AsConst(*this).TransformCurves([&GetSettings, &bChanged, &bInterpModeChanged](FName Key, const auto& Curve)
+	{
+		EInterpCurveMode InterpMode = Curve.GetTrack()->InterpMode;
+		int32 BakeSamples;
+		EMetaSplineCompression Compression;
+		if (GetSettings(Key, InterpMode, BakeSamples, Compression))
+		{
+			bInterpModeChanged |= Curve.GetTrack()->InterpMode != InterpMode;
+			bChanged |= Curve.GetTrack()->BakeSamplesPerSegment != BakeSamples || Curve.GetTrack()->Compression != Compression;
+		}
+	});
+
+	if (!bChanged && !bInterpModeChanged)
+	{
+		return;
+	}
+
+	TransformCurves([&GetSettings](FName Key, auto& Curve)
+	{
+		EInterpCurveMode InterpMode = Curve.GetTrack()->InterpMode;
+		int32 BakeSamples;
+		EMetaSplineCompression Compression;
+		if (GetSettings(Key, InterpMode, BakeSamples, Compression))
+		{
+			Curve.GetTrack()->InterpMode = InterpMode;
+			Curve.GetTrack()->BakeSamplesPerSegment = BakeSamples;
+			Curve.GetTrack()->Compression = Compression;
+		}
+	});
+
+	// The tangents of every point have to be computed, or cleared, for the new mode.
+	if (bInterpModeChanged)
+	{
+		MarkAllPointsDirty();
+	}
+}
+#endif
+
+void UMetaSplineMetadata::BakeTracks(int32 InDefaultSamplesPerSegment)
+{
+	// Modifying a track clears its lookup table, so a table of the right size is up to date. Shared storage is usually baked already.
+	const auto GetSamples = [InDefaultSamplesPerSegment](const auto* Track) { return Track->BakeSamplesPerSegment > 0 ? Track->BakeSamplesPerSegment : InDefaultSamplesPerSegment; };
+
+	bool bIsBaked = true;
+	AsConst(*this).TransformCurves([&GetSamples, &bIsBaked](const auto& Curve)
+	{
+		if (const auto* Track = Curve.GetTrack())
+		{
+			bIsBaked &= Track->Baked.Num() == Curve.GetNumBakeSamples(GetSamples(Track));
+		}
+	});
+
+	if (bIsBaked)
+	{
+		return;
+	}
+
+	TransformCurves([&GetSamples](auto& Curve)
+	{
+		if (const auto* Track = Curve.GetTrack())
+		{
+			Curve.Bake(GetSamples(Track));
+		}
+	});
+}
+
+void UMetaSplineMetadata::ClearBakedTracks()
+{
+	TransformCurves([](auto& Curve)
+	{
+		Curve.Bake(0);
+	});
+}
+
+float UMetaSplineMetadata::GetMaxBakeError() const
+{
+	float MaxError = 0.0f;
+	ForEachMetaSplineType([this, &MaxError](auto Tag)
+	{
+		using T = typename decltype(Tag)::Type;
+		const FMetaSplinePackedStorage& PackedStorage = GetPacked();
+		for (const auto& Track : PackedStorage.GetTracks<T>())
+		{
+			MaxError = FMath::Max(MaxError, TMetaSplineCurveView<const T>(&Track, &PackedStorage).GetMaxBakeError());
+		}
+	});
+	return MaxError;
+}
+
+void UMetaSplineMetadata::Serialize(FArchive& Ar)
+{
+	Ar.UsingCustomVersion(FMetaSplineCustomVersion::GUID);
+
+	// Transactions and other in-memory archives keep using the tagged properties.
+	const bool bBinaryTracks = Ar.IsPersistent() && !Ar.IsTextFormat() && Ar.CustomVer(FMetaSplineCustomVersion::GUID) >= FMetaSplineCustomVersion::BinaryTracks;
+
+	// A shared payload is written as if it was private. Anything loaded replaces the private copy.
+	const bool bSaveSharedPacked = Ar.IsSaving() && SharedPacked.IsValid();
+	if (bSaveSharedPacked)
+	{
+		Packed = *SharedPacked;
+	}
+	else if (Ar.IsLoading())
+	{
+		// This also counts as a modification of the curve maps, which are loaded directly.
+		GetMutablePacked();
+		++ChangeCounter;
+	}
+
+	// Keep the packed tracks out of the tagged properties when they are written in binary after them.
+	bool bHasBinaryTracks = bBinaryTracks && Ar.IsSaving() && Storage == EMetaSplineMetadataStorage::Packed;
+	FMetaSplinePackedStorage TaggedPacked;
+	if (bHasBinaryTracks)
+	{
+		Swap(Packed, TaggedPacked);
+	}
+
+	Super::Serialize(Ar);
+
+	if (bHasBinaryTracks)
+	{
+		Swap(Packed, TaggedPacked);
+	}
+
+	if (bBinaryTracks)
+	{
+		Ar << bHasBinaryTracks;
+		if (bHasBinaryTracks)
+		{
+			SerializeBinaryTracks(Ar);
+		}
+
+		// Duplicates can be made after the metadata was modified, so only trust the hash that was saved with the package.
+		if (Ar.CustomVer(FMetaSplineCustomVersion::GUID) >= FMetaSplineCustomVersion::CleanStateHash && !Ar.HasAnyPortFlags(PPF_Duplicate))
+		{
+			Ar << CleanStateHash;
+		}
+	}
+
+	if (bSaveSharedPacked)
+	{
+		Packed = FMetaSplinePackedStorage();
+	}
+}
+
+void UMetaSplineMetadata::SerializeBinaryTracks(FArchive& Ar)
+{
+	Ar << Packed.bIsLooped;
+	Ar << Packed.LoopKeyOffset;
+
+	ForEachMetaSplineType([this, &Ar](auto Tag)
+	{
+		using T = typename decltype(Tag)::Type;
+		auto& Tracks = Packed.GetTracks<T>();
+
+		int32 NumTracks = Tracks.Num();
+		Ar << NumTracks;
+		if (Ar.IsLoading())
+		{
+			Tracks.Reset();
+			Tracks.SetNum(NumTracks);
+		}
+
+		// Schema header for every track of this type, so the value blocks below are back to back.
+		for (auto& Track : Tracks)
+		{
+			Ar << Track.Name;
+			Ar << Track.InterpMode;
+			Ar << Track.BakeSamplesPerSegment;
+			Ar << Track.Compression;
+		}
+
+		for (auto& Track : Tracks)
+		{
+			// Compression only applies to cooked data, so the editor never loses precision.
+			EMetaSplineCompression StoredCompression = Ar.IsSaving() && Ar.IsCooking() ? Track.Compression : EMetaSplineCompression::None;
+			Ar << StoredCompression;
+
+			if (StoredCompression == EMetaSplineCompression::None)
+			{
+				Track.Values.BulkSerialize(Ar);
+				Track.Tangents.BulkSerialize(Ar);
+				continue;
+			}
+
+			FMetaSplineEncodedTrack Encoded;
+			Encoded.Compression = StoredCompression;
+			if (Ar.IsSaving())
+			{
+				FMetaSplineCompression::Encode(StoredCompression, Track.Values, Encoded);
+			}
+
+			Ar << Encoded;
+
+			if (Ar.IsLoading())
+			{
+				// The tangents are left empty, which makes the next AutoSetTangents() rebuild all of them.
+				FMetaSplineCompression::Decode(Encoded, Track.Values);
+				Track.Tangents.Reset();
+			}
+		}
+	});
+}
+
+void UMetaSplineMetadata::PostLoad()
+{
+	Super::PostLoad();
+
+	// Metadata saved before packed storage existed has its data in the curve maps, but defaults to packed storage.
+	// Curves that can't be packed without losing data stay in curve storage.
+	if (Storage == EMetaSplineMetadataStorage::Packed && !CanPackCurveMaps())
+	{
+		Storage = EMetaSplineMetadataStorage::Curves;
+	}
+	else if (Storage == EMetaSplineMetadataStorage::Packed)
+	{
+		ForEachMetaSplineType([this](auto Tag)
+		{
+			using T = typename decltype(Tag)::Type;
+			if (FindCurveMapForType<T>().Num() > 0)
+			{
+				MoveCurvesToTracks<T>();
+			}
+		});
+	}
+}
+
+bool UMetaSplineMetadata::IsRecordingPointChanges() const
+{
+#if WITH_EDITOR
+	return GUndo && HasAnyFlags(RF_Transactional);
+#else
+	return false;
+#endif
+}
+
+void UMetaSplineMetadata::RecordPointChange(EMetaSplinePointChange InType, int32 InIndex, FMetaSplinePointValues&& InBefore)
+{
+#if WITH_EDITOR
+	if (IsRecordingPointChanges())
+	{
+		FMetaSplinePointValues After;
+		if (InType != EMetaSplinePointChange::Remove)
+		{
+			CapturePoint(InIndex, After);
+		}
+		GUndo->StoreUndo(this, MakeUnique<FMetaSplinePointChange>(InType, InIndex, MoveTemp(InBefore), MoveTemp(After)));
+	}
+
+	MarkPackageDirty();
+#endif
+}
+
+void UMetaSplineMetadata::CapturePoint(int32 InIndex, FMetaSplinePointValues& OutValues) const
+{
+	TransformCurves([InIndex, &OutValues](const auto& Curve)
+	{
+		using T = typename TDecay<decltype(Curve)>::Type::ValueType;
+		OutValues.Get<T>().Add(Curve.GetValue(InIndex));
+	});
+}
+
+bool UMetaSplineMetadata::MatchesCurves(const FMetaSplinePointValues& InValues) const
+{
+	int32 NumValues[static_cast<int32>(EMetaSplinePropertyType::Num)] = {};
+	TransformCurves([&NumValues](const auto& Curve)
+	{
+		using T = typename TDecay<decltype(Curve)>::Type::ValueType;
+		NumValues[static_cast<int32>(TMetaSplinePropertyType<T>::Value)]++;
+	});
+
+	bool bMatches = true;
+	ForEachMetaSplineType([&InValues, &NumValues, &bMatches](auto Tag)
+	{
+		using T = typename decltype(Tag)::Type;
+		bMatches &= InValues.Get<T>().Num() == NumValues[static_cast<int32>(TMetaSplinePropertyType<T>::Value)];
+	});
+	return bMatches;
+}
+
+void UMetaSplineMetadata::InsertPointValues(int32 InIndex, const FMetaSplinePointValues& InValues)
+{
+	// The meta class may have changed since the values were recorded.
+	if (InIndex < 0 || InIndex > NumPoints || !MatchesCurves(InValues))
+	{
+		return;
+	}
+
+	int32 NextValue[static_cast<int32>(EMetaSplinePropertyType::Num)] = {};
+	TransformCurves([InIndex, &InValues, &NextValue](auto& Curve)
+	{
+		using T = typename TDecay<decltype(Curve)>::Type::ValueType;
+		Curve.Insert(InIndex, InValues.Get<T>()[NextValue[static_cast<int32>(TMetaSplinePropertyType<T>::Value)]++]);
+	});
+
+	NumPoints++;
+	StaleKeysFrom = FMath::Min(StaleKeysFrom, InIndex);
+
+	ShiftDirtyPoints(InIndex, 1);
+	MarkPointsDirty(InIndex);
+}
+
+void UMetaSplineMetadata::RemovePointValues(int32 InIndex)
+{
+	if (InIndex < 0 || InIndex >= NumPoints)
+	{
+		return;
+	}
+
+	TransformCurves([InIndex](auto& Curve)
+	{
+		Curve.RemoveAt(InIndex);
+	});
+
+	NumPoints--;
+	StaleKeysFrom = FMath::Min(StaleKeysFrom, InIndex);
+
+	// The points on either side of the removed one are now neighbours.
+	ShiftDirtyPoints(InIndex, -1);
+	MarkPointsDirty(InIndex - 1, InIndex + 1);
+}
+
+void UMetaSplineMetadata::SetPointValues(int32 InIndex, const FMetaSplinePointValues& InValues)
+{
+	if (InIndex < 0 || InIndex >= NumPoints || !MatchesCurves(InValues))
+	{
+		return;
+	}
+
+	int32 NextValue[static_cast<int32>(EMetaSplinePropertyType::Num)] = {};
+	TransformCurves([InIndex, &InValues, &NextValue](auto& Curve)
+	{
+		using T = typename TDecay<decltype(Curve)>::Type::ValueType;
+		Curve.SetValue(InIndex, InValues.Get<T>()[NextValue[static_cast<int32>(TMetaSplinePropertyType<T>::Value)]++]);
+	});
+
+	MarkPointsDirty(InIndex);
+}
+
+void UMetaSplineMetadata::RecordPropertyChange(FName InProperty, TArray<int32>&& InIndices, FMetaSplinePointValues&& InBefore, FMetaSplinePointValues&& InAfter)
+{
+#if WITH_EDITOR
+	if (IsRecordingPointChanges())
+	{
+		GUndo->StoreUndo(this, MakeUnique<FMetaSplinePropertyChange>(InProperty, MoveTemp(InIndices), MoveTemp(InBefore), MoveTemp(InAfter)));
+	}
+
+	MarkPackageDirty();
+#endif
+}
+
+void UMetaSplineMetadata::SetPropertyValues(FName InProperty, const TArray<int32>& InIndices, const FMetaSplinePointValues& InValues)
+{
+	ForEachMetaSplineType([this, InProperty, &InIndices, &InValues](auto Tag)
+	{
+		using T = typename decltype(Tag)::Type;
+		const TArray<T>& Values = InValues.Get<T>();
+		if (Values.Num() == 0 || Values.Num() != InIndices.Num())
+		{
+			return;
+		}
+
+		// The meta class may have changed since the values were recorded. Looking the curve up for writing copies shared
+		// storage, so it is only done once the curve is known to exist.
+		if (!AsConst(*this).FindCurve<T>(InProperty))
+		{
+			return;
+		}
+
+		const auto Curve = FindCurve<T>(InProperty);
+		for (int32 i = 0; i < InIndices.Num(); i++)
+		{
+			if (InIndices[i] >= 0 && InIndices[i] < Curve.Num())
+			{
+				Curve->SetValue(InIndices[i], Values[i]);
+				MarkPointsDirty(InIndices[i]);
+			}
+		}
+	});
+}
+
+void UMetaSplineMetadata::PostTransacted(const FTransactionObjectEvent& TransactionEvent)
+{
+	Super::PostTransacted(TransactionEvent);
+
+	// Restoring a snapshot from Modify() can change any number of points. Point changes mark their own points.
+	if (TransactionEvent.HasPropertyChanges() || TransactionEvent.HasNonPropertyChanges())
+	{
+		MarkAllPointsDirty();
+		StaleKeysFrom = 0;
+	}
 
-	// Rerun construction script after each transaction.
-	GetTypedOuter<AActor>()->PostEditMove(false);
+	// Rerun construction script after each transaction. Reruns are queued, so a transaction touching many objects only reruns it once.
+	// Point changes request their own rerun, in case this isn't called for transactions that only hold those.
+	FMetaSplineConstructionQueue::RequestRerun(GetTypedOuter<AActor>());
 }
@@ -0,0 +1,68 @@
+// Copyright(c) 2021 Viktor Pramberg
+#include "MetaSplinePointChange.h"
+
+#if WITH_EDITOR
+#include "MetaSplineMetadata.h"
+#include "MetaSplineConstructionQueue.h"
+#include "GameFramework/Actor.h"
+
+namespace MetaSplinePointChange_Private
+{
+	// A transaction holding only custom changes isn't guaranteed to call PostTransacted() on the metadata, so each replayed change
+	// requests the rerun that synchronizes the spline and publishes its snapshot. The rest of the transaction, like the points of
+	// the spline itself, may not be restored yet, so the rerun always waits for the next tick.
+	void RequestRerun(UMetaSplineMetadata* InMetadata)
+	{
+		FMetaSplineConstructionQueue::RequestDeferredRerun(InMetadata->GetTypedOuter<AActor>());
+	}
+}
+
+void FMetaSplinePointChange::Apply(UObject* Object)
+{
+	UMetaSplineMetadata* Metadata = CastChecked<UMetaSplineMetadata>(Object);
+	switch (Type)
+	{
+	case EMetaSplinePointChange::Insert:	Metadata->InsertPointValues(Index, After); break;
+	case EMetaSplinePointChange::Remove:	Metadata->RemovePointValues(Index); break;
+	case EMetaSplinePointChange::Set:	Metadata->SetPointValues(Index, After); break;
+	}
+	MetaSplinePointChange_Private::RequestRerun(Metadata);
+}
+
+void FMetaSplinePointChange::Revert(UObject* Object)
+{
+	UMetaSplineMetadata* Metadata = CastChecked<UMetaSplineMetadata>(Object);
+	switch (Type)
+	{
+	case EMetaSplinePointChange::Insert:	Metadata->RemovePointValues(Index); break;
+	case EMetaSplinePointChange::Remove:	Metadata->InsertPointValues(Index, Before); break;
+	case EMetaSplinePointChange::Set:	Metadata->SetPointValues(Index, Before); break;
+	}
+	MetaSplinePointChange_Private::RequestRerun(Metadata);
+}
+
+FString FMetaSplinePointChange::ToString() const
+{
+	static const TCHAR* TypeNames[] = { TEXT("Insert"), TEXT("Remove"), TEXT("Set") };
+	return FString::Printf(TEXT("MetaSpline point change (%s %d)"), TypeNames[static_cast<int32>(Type)], Index);
+}
+
+void FMetaSplinePropertyChange::Apply(UObject* Object)
+{
+	UMetaSplineMetadata* Metadata = CastChecked<UMetaSplineMetadata>(Object);
+	Metadata->SetPropertyValues(Property, Indices, After);
+	MetaSplinePointChange_Private::RequestRerun(Metadata);
+}
+
+void FMetaSplinePropertyChange::Revert(UObject* Object)
+{
+	UMetaSplineMetadata* Metadata = CastChecked<UMetaSplineMetadata>(Object);
+	Metadata->SetPropertyValues(Property, Indices, Before);
+	MetaSplinePointChange_Private::RequestRerun(Metadata);
+}
+
+FString FMetaSplinePropertyChange::ToString() const
+{
+	return FString::Printf(TEXT("MetaSpline property change (%s, %d points)"), *Property.ToString(), Indices.Num());
+}
+#endif
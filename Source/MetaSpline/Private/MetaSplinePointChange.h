@@ -0,0 +1,92 @@
+// Copyright(c) 2021 Viktor Pramberg
+#pragma once
+#include "CoreMinimal.h"
+#include "MetaSplineTrack.h"
+
+/**
+ * The values of every curve at a single point, in the order UMetaSplineMetadata::TransformCurves() visits the curves.
+ */
+struct FMetaSplinePointValues
+{
+	TArray<float> Floats;
+	TArray<FVector> Vectors;
+	TArray<FQuat> Quats;
+	TArray<FLinearColor> LinearColors;
+	TArray<FVector2D> Vector2Ds;
+
+	template<typename T> decltype(auto) Get() const { return Get_Implementation<T>(this); }
+	template<typename T> decltype(auto) Get() { return Get_Implementation<T>(this); }
+
+private:
+	template<typename T, typename TSelf>
+	static decltype(auto) Get_Implementation(TSelf* InSelf)
+	{
+		if constexpr (TIsSame<T, float>::Value) { return (InSelf->Floats); }
+		else if constexpr (TIsSame<T, FVector>::Value) { return (InSelf->Vectors); }
+		else if constexpr (TIsSame<T, FQuat>::Value) { return (InSelf->Quats); }
+		else if constexpr (TIsSame<T, FLinearColor>::Value) { return (InSelf->LinearColors); }
+		else if constexpr (TIsSame<T, FVector2D>::Value) { return (InSelf->Vector2Ds); }
+		else { static_assert(false, "Value type not supported!"); }
+	}
+};
+
+enum class EMetaSplinePointChange : uint8
+{
+	Insert,
+	Remove,
+	Set,
+};
+
+#if WITH_EDITOR
+#include "Misc/Change.h"
+#include "Misc/ITransaction.h"
+
+/**
+ * Undo record for a single point edit on UMetaSplineMetadata. Holds only the values of the affected point, instead of
+ * a snapshot of every curve like Modify() does.
+ */
+class FMetaSplinePointChange : public FCommandChange
+{
+public:
+	FMetaSplinePointChange(EMetaSplinePointChange InType, int32 InIndex, FMetaSplinePointValues&& InBefore, FMetaSplinePointValues&& InAfter)
+		: Type(InType), Index(InIndex), Before(MoveTemp(InBefore)), After(MoveTemp(InAfter))
+	{
+	}
+
+	virtual void Apply(UObject* Object) override;
+	virtual void Revert(UObject* Object) override;
+	virtual FString ToString() const override;
+
+private:
+	EMetaSplinePointChange Type;
+	int32 Index;
+
+	// The values before a removal or modification, and after an insertion or modification.
+	FMetaSplinePointValues Before;
+	FMetaSplinePointValues After;
+};
+
+/**
+ * Undo record for a bulk write to a single property of UMetaSplineMetadata. Holds only the written values of that property.
+ */
+class FMetaSplinePropertyChange : public FCommandChange
+{
+public:
+	FMetaSplinePropertyChange(FName InProperty, TArray<int32>&& InIndices, FMetaSplinePointValues&& InBefore, FMetaSplinePointValues&& InAfter)
+		: Property(InProperty), Indices(MoveTemp(InIndices)), Before(MoveTemp(InBefore)), After(MoveTemp(InAfter))
+	{
+	}
+
+	virtual void Apply(UObject* Object) override;
+	virtual void Revert(UObject* Object) override;
+	virtual FString ToString() const override;
+
+private:
+	FName Property;
+	TArray<int32> Indices;
+
+	// One value per index, in the array of the property type.
+	FMetaSplinePointValues Before;
+	FMetaSplinePointValues After;
+};
+#endif
@@ -0,0 +1,87 @@
+// Copyright(c) 2021 Viktor Pramberg
+#include "MetaSplinePropertyLayout.h"
+
+const FMetaSplineStructLayout& FMetaSplineStructLayout::Get(const UStruct* InStruct)
+{
+	check(IsInGameThread());
+
+	static TMap<const UStruct*, TUniquePtr<FMetaSplineStructLayout>> Layouts;
+	static const FMetaSplineStructLayout EmptyLayout;
+
+	if (!InStruct)
+	{
+		return EmptyLayout;
+	}
+
+	TUniquePtr<FMetaSplineStructLayout>& Layout = Layouts.FindOrAdd(InStruct);
+	if (!Layout)
+	{
+		Layout = MakeUnique<FMetaSplineStructLayout>();
+	}
+
+	if (!Layout->IsUpToDate(InStruct))
+	{
+		Layout->Build(InStruct);
+	}
+	return *Layout;
+}
+
+EMetaSplinePropertyType FMetaSplineStructLayout::GetPropertyType(const FProperty* InProperty)
+{
+	if (InProperty->IsA<FFloatProperty>())
+	{
+		return EMetaSplinePropertyType::Float;
+	}
+
+	if (const FStructProperty* StructProperty = CastField<FStructProperty>(InProperty))
+	{
+		const UScriptStruct* Struct = StructProperty->Struct;
+		if (Struct == TBaseStructure<FVector>::Get())
+		{
+			return EMetaSplinePropertyType::Vector;
+		}
+		if (Struct == TBaseStructure<FQuat>::Get())
+		{
+			return EMetaSplinePropertyType::Quat;
+		}
+		if (Struct == TBaseStructure<FLinearColor>::Get())
+		{
+			return EMetaSplinePropertyType::LinearColor;
+		}
+		if (Struct == TBaseStructure<FVector2D>::Get())
+		{
+			return EMetaSplinePropertyType::Vector2D;
+		}
+	}
+
+	return EMetaSplinePropertyType::Unsupported;
+}
+
+bool FMetaSplineStructLayout::IsUpToDate(const UStruct* InStruct) const
+{
+	// The weak pointer catches a new struct allocated where a destroyed one used to be.
+	return Struct.Get() == InStruct && FirstProperty == InStruct->PropertyLink && PropertiesSize == InStruct->GetPropertiesSize();
+}
+
+void FMetaSplineStructLayout::Build(const UStruct* InStruct)
+{
+	Struct = InStruct;
+	FirstProperty = InStruct->PropertyLink;
+	PropertiesSize = InStruct->GetPropertiesSize();
+
+	Properties.Reset();
+	NameToIndex.Reset();
+
+	int32 NumSlots[static_cast<int32>(EMetaSplinePropertyType::Num) + 1] = {};
+	for (TFieldIterator<FProperty> It(InStruct); It; ++It)
+	{
+		FMetaSplinePropertyLayout& Layout = Properties.AddDefaulted_GetRef();
+		Layout.Property = *It;
+		Layout.Name = It->GetFName();
+		Layout.Type = GetPropertyType(*It);
+		Layout.Offset = It->GetOffset_ForInternal();
+		Layout.Slot = Layout.Type != EMetaSplinePropertyType::Unsupported ? NumSlots[static_cast<int32>(Layout.Type)]++ : INDEX_NONE;
+
+		NameToIndex.Add(Layout.Name, Properties.Num() - 1);
+	}
+}
@@ -0,0 +1,56 @@
+// Copyright(c) 2021 Viktor Pramberg
+#pragma once
+#include "CoreMinimal.h"
+#include "MetaSplineTrack.h"
+
+/**
+ * A property of a meta class or container struct, resolved once so it can be read without reflection lookups.
+ */
+struct FMetaSplinePropertyLayout
+{
+	const FProperty* Property = nullptr;
+	FName Name;
+	EMetaSplinePropertyType Type = EMetaSplinePropertyType::Unsupported;
+
+	// Offset of the value in an instance of the owning struct.
+	int32 Offset = 0;
+
+	// Index among the properties of the same type, which is also the index of its packed track.
+	int32 Slot = INDEX_NONE;
+
+	template<typename T> T& GetValue(void* InContainer) const { return *reinterpret_cast<T*>(static_cast<uint8*>(InContainer) + Offset); }
+	template<typename T> const T& GetValue(const void* InContainer) const { return *reinterpret_cast<const T*>(static_cast<const uint8*>(InContainer) + Offset); }
+};
+
+/**
+ * The metadata relevant properties of a struct or class, in field order. Built the first time a struct is used, and cached.
+ */
+class METASPLINE_API FMetaSplineStructLayout
+{
+public:
+	/** Returns the layout of InStruct. Only call this from the game thread. */
+	static const FMetaSplineStructLayout& Get(const UStruct* InStruct);
+
+	static EMetaSplinePropertyType GetPropertyType(const FProperty* InProperty);
+
+	/** All properties of the struct, including ones with unsupported types. */
+	const TArray<FMetaSplinePropertyLayout>& GetProperties() const { return Properties; }
+
+	const FMetaSplinePropertyLayout* Find(FName InName) const
+	{
+		const int32* Index = NameToIndex.Find(InName);
+		return Index ? &Properties[*Index] : nullptr;
+	}
+
+private:
+	void Build(const UStruct* InStruct);
+	bool IsUpToDate(const UStruct* InStruct) const;
+
+	TWeakObjectPtr<const UStruct> Struct;
+	TArray<FMetaSplinePropertyLayout> Properties;
+	TMap<FName, int32> NameToIndex;
+
+	// Recompiling a Blueprint replaces the properties of its class in place, which changes these.
+	const FProperty* FirstProperty = nullptr;
+	int32 PropertiesSize = 0;
+};
@@ -0,0 +1,121 @@
+// Copyright(c) 2021 Viktor Pramberg
+#include "MetaSplineSnapshot.h"
+
+int32 FMetaSplineSnapshot::GetNumberOfSplinePoints() const
+{
+	return SplineData->SplineCurves.Position.Points.Num();
+}
+
+float FMetaSplineSnapshot::GetSplineLength() const
+{
+	return SplineData->SplineCurves.GetSplineLength();
+}
+
+FVector FMetaSplineSnapshot::GetLocationAtSplineInputKey(float InKey, ESplineCoordinateSpace::Type InCoordinateSpace) const
+{
+	const FVector Location = SplineData->SplineCurves.Position.Eval(InKey, FVector::ZeroVector);
+	return InCoordinateSpace == ESplineCoordinateSpace::World ? ComponentTransform.TransformPosition(Location) : Location;
+}
+
+FVector FMetaSplineSnapshot::GetLocationAtDistanceAlongSpline(float InDistance, ESplineCoordinateSpace::Type InCoordinateSpace) const
+{
+	return GetLocationAtSplineInputKey(GetMetadataKeyAtDistance(InDistance), InCoordinateSpace);
+}
+
+// -- Metadata accessors --
+float FMetaSplineSnapshot::GetMetadataFloatAtPoint(FName InProperty, int32 InIndex) const
+{
+	return GetMetadataFloatAtKey(InProperty, static_cast<float>(InIndex));
+}
+
+FVector FMetaSplineSnapshot::GetMetadataVectorAtPoint(FName InProperty, int32 InIndex) const
+{
+	return GetMetadataVectorAtKey(InProperty, static_cast<float>(InIndex));
+}
+
+float FMetaSplineSnapshot::GetMetadataFloatAtKey(FName InProperty, float InKey) const
+{
+	return GetMetadataAtKey<float>(InProperty, InKey);
+}
+
+FVector FMetaSplineSnapshot::GetMetadataVectorAtKey(FName InProperty, float InKey) const
+{
+	return GetMetadataAtKey<FVector>(InProperty, InKey);
+}
+
+FRotator FMetaSplineSnapshot::GetMetadataRotatorAtPoint(FName InProperty, int32 InIndex) const
+{
+	return GetMetadataRotatorAtKey(InProperty, static_cast<float>(InIndex));
+}
+
+FRotator FMetaSplineSnapshot::GetMetadataRotatorAtKey(FName InProperty, float InKey) const
+{
+	return GetMetadataAtKey<FQuat>(InProperty, InKey).Rotator();
+}
+
+FLinearColor FMetaSplineSnapshot::GetMetadataColorAtPoint(FName InProperty, int32 InIndex) const
+{
+	return GetMetadataColorAtKey(InProperty, static_cast<float>(InIndex));
+}
+
+FLinearColor FMetaSplineSnapshot::GetMetadataColorAtKey(FName InProperty, float InKey) const
+{
+	return GetMetadataAtKey<FLinearColor>(InProperty, InKey);
+}
+
+FVector2D FMetaSplineSnapshot::GetMetadataVector2DAtPoint(FName InProperty, int32 InIndex) const
+{
+	return GetMetadataVector2DAtKey(InProperty, static_cast<float>(InIndex));
+}
+
+FVector2D FMetaSplineSnapshot::GetMetadataVector2DAtKey(FName InProperty, float InKey) const
+{
+	return GetMetadataAtKey<FVector2D>(InProperty, InKey);
+}
+
+// -- Handle based metadata accessors --
+float FMetaSplineSnapshot::GetMetadataFloatAtPoint(const FMetaSplinePropertyHandle& InHandle, int32 InIndex) const
+{
+	return GetMetadataFloatAtKey(InHandle, static_cast<float>(InIndex));
+}
+
+FVector FMetaSplineSnapshot::GetMetadataVectorAtPoint(const FMetaSplinePropertyHandle& InHandle, int32 InIndex) const
+{
+	return GetMetadataVectorAtKey(InHandle, static_cast<float>(InIndex));
+}
+
+float FMetaSplineSnapshot::GetMetadataFloatAtKey(const FMetaSplinePropertyHandle& InHandle, float InKey) const
+{
+	return GetMetadataAtKey<float>(InHandle, InKey);
+}
+
+FVector FMetaSplineSnapshot::GetMetadataVectorAtKey(const FMetaSplinePropertyHandle& InHandle, float InKey) const
+{
+	return GetMetadataAtKey<FVector>(InHandle, InKey);
+}
+
+// -- Distance based metadata accessors --
+float FMetaSplineSnapshot::GetMetadataKeyAtDistance(float InDistance) const
+{
+	return SplineData->DistanceIndex.GetKeyAtDistance(SplineData->SplineCurves.ReparamTable, InDistance);
+}
+
+float FMetaSplineSnapshot::GetMetadataFloatAtDistance(FName InProperty, float InDistance) const
+{
+	return GetMetadataFloatAtKey(InProperty, GetMetadataKeyAtDistance(InDistance));
+}
+
+FVector FMetaSplineSnapshot::GetMetadataVectorAtDistance(FName InProperty, float InDistance) const
+{
+	return GetMetadataVectorAtKey(InProperty, GetMetadataKeyAtDistance(InDistance));
+}
+
+float FMetaSplineSnapshot::GetMetadataFloatAtDistance(const FMetaSplinePropertyHandle& InHandle, float InDistance) const
+{
+	return GetMetadataFloatAtKey(InHandle, GetMetadataKeyAtDistance(InDistance));
+}
+
+FVector FMetaSplineSnapshot::GetMetadataVectorAtDistance(const FMetaSplinePropertyHandle& InHandle, float InDistance) const
+{
+	return GetMetadataVectorAtKey(InHandle, GetMetadataKeyAtDistance(InDistance));
+}
@@ -0,0 +1,188 @@
+// Copyright(c) 2021 Viktor Pramberg
+#include "MetaSplineSubsystem.h"
+#include "MetaSplineComponent.h"
+#include "ConvexVolume.h"
+#include "Algo/Sort.h"
+
+namespace MetaSplineSubsystem_Private
+{
+	constexpr int32 MaxElementsPerLeaf = 4;
+}
+
+void UMetaSplineSubsystem::RegisterComponent(UMetaSplineComponent* InComponent)
+{
+	Components.AddUnique(InComponent);
+	bHierarchyDirty = true;
+}
+
+void UMetaSplineSubsystem::UnregisterComponent(UMetaSplineComponent* InComponent)
+{
+	Components.RemoveSingleSwap(InComponent);
+	bHierarchyDirty = true;
+}
+
+void UMetaSplineSubsystem::MarkBoundsDirty(const UMetaSplineComponent* InComponent)
+{
+	if (bHierarchyDirty)
+	{
+		return;
+	}
+
+	if (const int32* Element = ElementIndices.Find(InComponent))
+	{
+		MovedElements.AddUnique(*Element);
+	}
+}
+
+void UMetaSplineSubsystem::GetComponentsInFrustum(const FConvexVolume& InFrustum, TArray<UMetaSplineComponent*>& OutComponents)
+{
+	if (!bHierarchyDirty && MovedElements.Num() > 0)
+	{
+		RefitHierarchy();
+	}
+
+	if (bHierarchyDirty)
+	{
+		BuildHierarchy();
+	}
+
+	if (Nodes.Num() == 0)
+	{
+		return;
+	}
+
+	TArray<int32, TInlineAllocator<64>> Stack;
+	Stack.Add(0);
+	while (Stack.Num() > 0)
+	{
+		const FNode& Node = Nodes[Stack.Pop(false)];
+		if (!InFrustum.IntersectBox(Node.Bounds.GetCenter(), Node.Bounds.GetExtent()))
+		{
+			continue;
+		}
+
+		if (Node.Count == 0)
+		{
+			Stack.Add(Node.Children[0]);
+			Stack.Add(Node.Children[1]);
+			continue;
+		}
+
+		for (int32 i = Node.First; i < Node.First + Node.Count; i++)
+		{
+			// The components are garbage collected in the editor without being unregistered, which clears them here.
+			const int32 Element = ElementOrder[i];
+			const FBox& Bounds = ElementBounds[Element];
+			if (IsValid(Components[Element]) && (Node.Count == 1 || InFrustum.IntersectBox(Bounds.GetCenter(), Bounds.GetExtent())))
+			{
+				OutComponents.Add(Components[Element]);
+			}
+		}
+	}
+}
+
+void UMetaSplineSubsystem::BuildHierarchy()
+{
+	bHierarchyDirty = false;
+	Nodes.Reset();
+	MovedElements.Reset();
+	NumRefitElements = 0;
+
+	// Components are unregistered before they are destroyed, but not necessarily before they are garbage collected in the editor.
+	Components.RemoveAllSwap([](const UMetaSplineComponent* Component) { return !IsValid(Component); });
+
+	ElementBounds.SetNumUninitialized(Components.Num());
+	ElementOrder.SetNumUninitialized(Components.Num());
+	ElementLeaves.SetNumUninitialized(Components.Num());
+	ElementIndices.Reset();
+	for (int32 i = 0; i < Components.Num(); i++)
+	{
+		ElementBounds[i] = Components[i]->Bounds.GetBox();
+		ElementOrder[i] = i;
+		ElementIndices.Add(Components[i], i);
+	}
+
+	if (Components.Num() > 0)
+	{
+		Nodes.Reserve(2 * Components.Num() / MetaSplineSubsystem_Private::MaxElementsPerLeaf + 1);
+		BuildNode(0, Components.Num(), INDEX_NONE);
+	}
+}
+
+void UMetaSplineSubsystem::RefitHierarchy()
+{
+	NumRefitElements += MovedElements.Num();
+	if (NumRefitElements > Components.Num())
+	{
+		bHierarchyDirty = true;
+		return;
+	}
+
+	for (const int32 Element : MovedElements)
+	{
+		if (const UMetaSplineComponent* Component = Components[Element])
+		{
+			ElementBounds[Element] = Component->Bounds.GetBox();
+		}
+
+		// Nodes above several moved elements are refit once for each of them, which is cheap since the tree is shallow.
+		for (int32 NodeIndex = ElementLeaves[Element]; NodeIndex != INDEX_NONE; NodeIndex = Nodes[NodeIndex].Parent)
+		{
+			FNode& Node = Nodes[NodeIndex];
+			Node.Bounds.Init();
+			if (Node.Count > 0)
+			{
+				for (int32 i = Node.First; i < Node.First + Node.Count; i++)
+				{
+					Node.Bounds += ElementBounds[ElementOrder[i]];
+				}
+			}
+			else
+			{
+				Node.Bounds = Nodes[Node.Children[0]].Bounds + Nodes[Node.Children[1]].Bounds;
+			}
+		}
+	}
+
+	MovedElements.Reset();
+}
+
+int32 UMetaSplineSubsystem::BuildNode(int32 InBegin, int32 InEnd, int32 InParent)
+{
+	const int32 NodeIndex = Nodes.AddDefaulted();
+	Nodes[NodeIndex].Parent = InParent;
+
+	FBox Bounds(ForceInit);
+	FBox CenterBounds(ForceInit);
+	for (int32 i = InBegin; i < InEnd; i++)
+	{
+		Bounds += ElementBounds[ElementOrder[i]];
+		CenterBounds += ElementBounds[ElementOrder[i]].GetCenter();
+	}
+	Nodes[NodeIndex].Bounds = Bounds;
+
+	if (InEnd - InBegin <= MetaSplineSubsystem_Private::MaxElementsPerLeaf)
+	{
+		Nodes[NodeIndex].First = InBegin;
+		Nodes[NodeIndex].Count = InEnd - InBegin;
+		for (int32 i = InBegin; i < InEnd; i++)
+		{
+			ElementLeaves[ElementOrder[i]] = NodeIndex;
+		}
+		return NodeIndex;
+	}
+
+	// Split at the median along the axis where the centers are spread out the most.
+	const FVector Size = CenterBounds.GetSize();
+	const int32 Axis = Size.X >= Size.Y && Size.X >= Size.Z ? 0 : (Size.Y >= Size.Z ? 1 : 2);
+	const int32 Middle = InBegin + (InEnd - InBegin) / 2;
+
+	const auto GetCenter = [this, Axis](int32 Element) { return ElementBounds[Element].GetCenter()[Axis]; };
+	Algo::Sort(MakeArrayView(ElementOrder.GetData() + InBegin, InEnd - InBegin), [&GetCenter](int32 A, int32 B) { return GetCenter(A) < GetCenter(B); });
+
+	const int32 Left = BuildNode(InBegin, Middle, NodeIndex);
+	const int32 Right = BuildNode(Middle, InEnd, NodeIndex);
+	Nodes[NodeIndex].Children[0] = Left;
+	Nodes[NodeIndex].Children[1] = Right;
+	return NodeIndex;
+}
@@ -1,6 +1,7 @@
 // Copyright(c) 2021 Viktor Pramberg
 #pragma once
 #include "CoreMinimal.h"
+#include "MetaSplinePropertyLayout.h"
 
 class FMetaSplineTemplateHelpers
 {
@@ -13,11 +14,22 @@ public:
 	template<template<typename> typename T, typename... FArgs>
 	static auto ExecuteOnProperty(const FProperty* InProperty, FArgs&&... InArgs)
 	{
-		const FName Type = FName(InProperty->GetCPPType());
-		if (Type == TEXT("float"))
-			return T<float>::Execute(InArgs...);
-		else if (Type == TEXT("FVector"))
-			return T<FVector>::Execute(InArgs...);
+		return ExecuteOnType<T>(FMetaSplineStructLayout::GetPropertyType(InProperty), InArgs...);
+	}
+
+	/** Same as ExecuteOnProperty(), for a type that has already been resolved, usually through FMetaSplineStructLayout. */
+	template<template<typename> typename T, typename... FArgs>
+	static auto ExecuteOnType(EMetaSplinePropertyType InType, FArgs&&... InArgs)
+	{
+		switch (InType)
+		{
+		case EMetaSplinePropertyType::Float:		return T<float>::Execute(InArgs...);
+		case EMetaSplinePropertyType::Vector:		return T<FVector>::Execute(InArgs...);
+		case EMetaSplinePropertyType::Quat:			return T<FQuat>::Execute(InArgs...);
+		case EMetaSplinePropertyType::LinearColor:	return T<FLinearColor>::Execute(InArgs...);
+		case EMetaSplinePropertyType::Vector2D:		return T<FVector2D>::Execute(InArgs...);
+		default:									break;
+		}
 
 		checkNoEntry();
 
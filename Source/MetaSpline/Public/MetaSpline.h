@@ -15,4 +15,8 @@ private:
 #if !UE_BUILD_SHIPPING
 	TUniquePtr<class FMetaSplineDebugRenderer> DebugRenderer;
 #endif
+
+#if WITH_EDITOR
+	TUniquePtr<class FMetaSplineConstructionQueue> ConstructionQueue;
+#endif
 };
@@ -4,9 +4,32 @@
 #include "CoreMinimal.h"
 #include "Components/SplineComponent.h"
 #include "MetaSplineMetadata.h"
+#include "Misc/ScopeRWLock.h"
 #include "MetaSplineComponent.generated.h"
 
 class UMetaSplineMetadata;
+class UMetaSplineComponent;
+class FMetaSplineSnapshot;
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnMetaSplineMetadataChanged, UMetaSplineComponent*);
+
+/**
+ * Accelerates distance to input key lookups in a spline's reparameterization table.
+ * The distance range is split into buckets that each know the first table point they contain, so a lookup only has to scan a few points.
+ */
+struct FMetaSplineDistanceIndex
+{
+	void Build(const FInterpCurveFloat& InReparamTable);
+	void Reset();
+
+	/** Same result as InReparamTable.Eval(InDistance, 0.0f). */
+	float GetKeyAtDistance(const FInterpCurveFloat& InReparamTable, float InDistance) const;
+
+private:
+	TArray<int32> BucketStart;
+	float InvBucketLength = 0.0f;
+	int32 NumTablePoints = 0;
+};
 
 /**
  * A spline component with a simple interface for adding metadata to spline points.
@@ -32,11 +55,156 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Spline|Metadata")
 	FVector GetMetadataVectorAtKey(FName InProperty, float InKey) const;
 
+	/** Reads a quaternion property. Blueprints have no quaternion type, so it is returned as a rotator. */
+	UFUNCTION(BlueprintCallable, Category = "Spline|Metadata")
+	FRotator GetMetadataRotatorAtPoint(FName InProperty, int32 InIndex) const;
+
+	UFUNCTION(BlueprintCallable, Category = "Spline|Metadata")
+	FRotator GetMetadataRotatorAtKey(FName InProperty, float InKey) const;
+
+	UFUNCTION(BlueprintCallable, Category = "Spline|Metadata")
+	FLinearColor GetMetadataColorAtPoint(FName InProperty, int32 InIndex) const;
+
+	UFUNCTION(BlueprintCallable, Category = "Spline|Metadata")
+	FLinearColor GetMetadataColorAtKey(FName InProperty, float InKey) const;
+
+	UFUNCTION(BlueprintCallable, Category = "Spline|Metadata")
+	FVector2D GetMetadataVector2DAtPoint(FName InProperty, int32 InIndex) const;
+
+	UFUNCTION(BlueprintCallable, Category = "Spline|Metadata")
+	FVector2D GetMetadataVector2DAtKey(FName InProperty, float InKey) const;
+
+	/** Reads a property of any supported type, by name or handle. */
+	template<typename T, typename TProperty>
+	T GetMetadataAtKey(const TProperty& InProperty, float InKey) const
+	{
+		const UMetaSplineMetadata* ConstMetadata = Metadata;
+		if (const auto Curve = ConstMetadata ? ConstMetadata->FindCurve<T>(InProperty) : TMetaSplineCurveView<const T>())
+		{
+			return Curve->Eval(InKey);
+		}
+		return T(ForceInit);
+	}
+
+	// -- Handle based metadata accessors --
+	/** Resolves a property of the current metadata class, so it can be read without a lookup by name. */
+	UFUNCTION(BlueprintCallable, Category = "Spline|Metadata")
+	FMetaSplinePropertyHandle ResolveMetadataProperty(FName InProperty) const;
+
+	/** Resolves a property of a meta class. The handle can be used with any spline using that class. */
+	UFUNCTION(BlueprintPure, Category = "Spline|Metadata")
+	static FMetaSplinePropertyHandle MakeMetadataPropertyHandle(TSubclassOf<UObject> InMetaClass, FName InProperty);
+
+	float GetMetadataFloatAtPoint(const FMetaSplinePropertyHandle& InHandle, int32 InIndex) const;
+	FVector GetMetadataVectorAtPoint(const FMetaSplinePropertyHandle& InHandle, int32 InIndex) const;
+	float GetMetadataFloatAtKey(const FMetaSplinePropertyHandle& InHandle, float InKey) const;
+	FVector GetMetadataVectorAtKey(const FMetaSplinePropertyHandle& InHandle, float InKey) const;
+
+	UFUNCTION(BlueprintCallable, Category = "Spline|Metadata", meta = (DisplayName = "Get Metadata Float At Point (Handle)"))
+	float GetMetadataFloatAtPointWithHandle(const FMetaSplinePropertyHandle& InHandle, int32 InIndex) const;
+
+	UFUNCTION(BlueprintCallable, Category = "Spline|Metadata", meta = (DisplayName = "Get Metadata Vector At Point (Handle)"))
+	FVector GetMetadataVectorAtPointWithHandle(const FMetaSplinePropertyHandle& InHandle, int32 InIndex) const;
+
+	UFUNCTION(BlueprintCallable, Category = "Spline|Metadata", meta = (DisplayName = "Get Metadata Float At Key (Handle)"))
+	float GetMetadataFloatAtKeyWithHandle(const FMetaSplinePropertyHandle& InHandle, float InKey) const;
+
+	UFUNCTION(BlueprintCallable, Category = "Spline|Metadata", meta = (DisplayName = "Get Metadata Vector At Key (Handle)"))
+	FVector GetMetadataVectorAtKeyWithHandle(const FMetaSplinePropertyHandle& InHandle, float InKey) const;
+
+	// -- Batched metadata accessors --
+	/** Evaluates a property at every key in InKeys. OutValues must be the same size as InKeys. */
+	void EvaluateMetadataBatch(const FMetaSplinePropertyHandle& InHandle, TArrayView<const float> InKeys, TArrayView<float> OutValues) const;
+	void EvaluateMetadataBatch(const FMetaSplinePropertyHandle& InHandle, TArrayView<const float> InKeys, TArrayView<FVector> OutValues) const;
+
+	UFUNCTION(BlueprintCallable, Category = "Spline|Metadata")
+	TArray<float> GetMetadataFloatAtKeys(const FMetaSplinePropertyHandle& InHandle, const TArray<float>& InKeys) const;
+
+	UFUNCTION(BlueprintCallable, Category = "Spline|Metadata")
+	TArray<FVector> GetMetadataVectorAtKeys(const FMetaSplinePropertyHandle& InHandle, const TArray<float>& InKeys) const;
+
+	// -- Metadata writers --
+	/**
+	 * Sets a property at every point in InIndices to the value at the same position in InValues.
+	 * All points are written in one transaction, followed by a single tangent update and OnMetadataChanged broadcast.
+	 * Returns the number of points whose value changed.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Spline|Metadata")
+	int32 SetMetadataFloatAtPoints(FName InProperty, const TArray<int32>& InIndices, const TArray<float>& InValues);
+
+	UFUNCTION(BlueprintCallable, Category = "Spline|Metadata")
+	int32 SetMetadataVectorAtPoints(FName InProperty, const TArray<int32>& InIndices, const TArray<FVector>& InValues);
+
+	/** Same as SetMetadataFloatAtPoints(), for InCount points starting at InFirstIndex that are all set to InValue. */
+	UFUNCTION(BlueprintCallable, Category = "Spline|Metadata")
+	int32 FillMetadataFloat(FName InProperty, int32 InFirstIndex, int32 InCount, float InValue);
+
+	UFUNCTION(BlueprintCallable, Category = "Spline|Metadata")
+	int32 FillMetadataVector(FName InProperty, int32 InFirstIndex, int32 InCount, const FVector& InValue);
+
+	/** Broadcast after metadata values were written through the functions above. */
+	FOnMetaSplineMetadataChanged OnMetadataChanged;
+
+	// -- Full record accessors --
+	/** Evaluates every metadata property at InKey, and writes them to the matching properties of OutInstance. Usually an instance of the meta class. */
+	UFUNCTION(BlueprintCallable, Category = "Spline|Metadata")
+	bool EvaluateAllMetadataAtKey(float InKey, UObject* OutInstance) const;
+
+	/** Evaluates every metadata property at InKey, and writes them to the properties with matching names and types in OutStruct. */
+	bool EvaluateAllMetadataAtKey(float InKey, const UScriptStruct* InStruct, void* OutStruct) const;
+
+	template<typename TStruct>
+	bool EvaluateAllMetadataAtKey(float InKey, TStruct& OutStruct) const
+	{
+		return EvaluateAllMetadataAtKey(InKey, TStruct::StaticStruct(), &OutStruct);
+	}
+
+	// -- Distance based metadata accessors --
+	UFUNCTION(BlueprintCallable, Category = "Spline|Metadata")
+	float GetMetadataFloatAtDistance(FName InProperty, float InDistance) const;
+
+	UFUNCTION(BlueprintCallable, Category = "Spline|Metadata")
+	FVector GetMetadataVectorAtDistance(FName InProperty, float InDistance) const;
+
+	float GetMetadataFloatAtDistance(const FMetaSplinePropertyHandle& InHandle, float InDistance) const;
+	FVector GetMetadataVectorAtDistance(const FMetaSplinePropertyHandle& InHandle, float InDistance) const;
+
+	/** Evaluates a property at every distance in InDistances. OutValues must be the same size as InDistances. */
+	void EvaluateMetadataBatchAtDistance(const FMetaSplinePropertyHandle& InHandle, TArrayView<const float> InDistances, TArrayView<float> OutValues) const;
+	void EvaluateMetadataBatchAtDistance(const FMetaSplinePropertyHandle& InHandle, TArrayView<const float> InDistances, TArrayView<FVector> OutValues) const;
+
+	UFUNCTION(BlueprintCallable, Category = "Spline|Metadata")
+	TArray<float> GetMetadataFloatAtDistances(const FMetaSplinePropertyHandle& InHandle, const TArray<float>& InDistances) const;
+
+	UFUNCTION(BlueprintCallable, Category = "Spline|Metadata")
+	TArray<FVector> GetMetadataVectorAtDistances(const FMetaSplinePropertyHandle& InHandle, const TArray<float>& InDistances) const;
+
+	/** Same as GetInputKeyAtDistanceAlongSpline(), but uses the distance index instead of a binary search. */
+	float GetMetadataKeyAtDistance(float InDistance) const;
+
+	/** Returns the largest difference between the baked lookup tables and the metadata curves they were baked from. */
+	UFUNCTION(BlueprintCallable, Category = "Spline|Metadata")
+	float GetMaxMetadataBakeError() const;
+
+	// -- Snapshots --
+	/** Returns the last snapshot published by the component, or null if bPublishSnapshots is disabled. Can be called from any thread. */
+	TSharedPtr<const FMetaSplineSnapshot, ESPMode::ThreadSafe> GetSnapshot() const;
+
 public:
 	// -- Overrides --
 	virtual TStructOnScope<FActorComponentInstanceData> GetComponentInstanceData() const override;
-	void ApplyComponentInstanceData(struct FMetaSplineInstanceData* ComponentInstanceData, const bool bPostUCS);
+	/** Applies the metadata and loop settings before the engine restores the points. Returns false if nothing should be applied. */
+	bool ApplyComponentInstanceData(struct FMetaSplineInstanceData* ComponentInstanceData, const bool bPostUCS);
+
+	/** Synchronizes the metadata with the points the engine restored. */
+	void FinishApplyComponentInstanceData(struct FMetaSplineInstanceData* ComponentInstanceData, const bool bPostUCS);
+	virtual void PreSave(const class ITargetPlatform* TargetPlatform) override;
 	virtual void PostLoad() override;
+	virtual void UpdateSpline() override;
+	virtual void OnRegister() override;
+	virtual void OnUnregister() override;
+	virtual void UpdateBounds() override;
+	virtual void OnUpdateTransform(EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport) override;
 
 #if WITH_EDITOR
 	virtual void PostEditImport() override;
@@ -54,13 +222,51 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Metadata)
 	bool bDrawDebugMetadata = true;
 
+	/** How the metadata is stored. Packed storage uses less memory and is faster to evaluate, curves are kept for compatibility. */
+	UPROPERTY(EditAnywhere, AdvancedDisplay, Category = Metadata)
+	EMetaSplineMetadataStorage MetadataStorage = EMetaSplineMetadataStorage::Packed;
+
+	/**
+	 * Resamples the packed metadata into lookup tables on load, so curves don't have to be evaluated at runtime.
+	 * The resolution is set in the project settings, or per property with the MetaSplineBakeSamples meta tag.
+	 * Only properties with a curve MetaSplineInterpMode are baked, since linear and constant ones are already as cheap as a lookup table.
+	 */
+	UPROPERTY(EditAnywhere, AdvancedDisplay, Category = Metadata)
+	bool bBakeMetadata = false;
+
+	/** Publishes an immutable snapshot of the spline and metadata whenever they change, so they can be sampled from other threads. See GetSnapshot(). */
+	UPROPERTY(EditAnywhere, AdvancedDisplay, Category = Metadata)
+	bool bPublishSnapshots = false;
+
 private:
 	void SynchronizeProperties();
 
+	/** SynchronizeProperties() without rebuilding the distance index, for when the spline was just updated. */
+	void SynchronizeMetadata();
+
+	/** Replaces the published snapshot with one of the current spline and metadata, or clears it if snapshots are disabled. */
+	void PublishSnapshot();
+
+	/** Hash of everything SynchronizeProperties() derives the metadata state from. Stable between sessions, since it is saved. */
+	uint32 GetMetadataStateHash() const;
+
+	/** Writes GetPoint(i) for i in [0, InNum) to a property, as described in SetMetadataFloatAtPoints(). */
+	template<typename T, typename FGetPoint>
+	int32 SetMetadataAtPoints(FName InProperty, int32 InNum, FGetPoint&& GetPoint);
+
+	template<typename T>
+	void EvaluateBatchAtDistance(const FMetaSplinePropertyHandle& InHandle, TArrayView<const float> InDistances, TArrayView<T> OutValues) const;
+
 private:
 	UPROPERTY(Instanced)
 	UMetaSplineMetadata* Metadata;
 
+	FMetaSplineDistanceIndex DistanceIndex;
+
+	// Written on the game thread only, but read from any thread.
+	TSharedPtr<const FMetaSplineSnapshot, ESPMode::ThreadSafe> Snapshot;
+	mutable FRWLock SnapshotLock;
+
 	static FProperty* MetadataProperty;
 	static FProperty* ClosedLoopProperty;
 	static FProperty* LoopPositionOverrideProperty;
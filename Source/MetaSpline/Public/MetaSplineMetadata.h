@@ -3,9 +3,15 @@
 
 #include "CoreMinimal.h"
 #include "Components/SplineComponent.h"
+#include "MetaSplineTrack.h"
 #include <UObject/UnrealType.h>
+#include <Misc/Optional.h>
 #include "MetaSplineMetadata.generated.h"
 
+struct FMetaSplinePropertyLayout;
+struct FMetaSplinePointValues;
+enum class EMetaSplinePointChange : uint8;
+
 namespace CurveUnderlyingType_Private
 {
 	template<typename T> struct TCurveUnderlyingTypeImpl { using Type = void; };
@@ -23,6 +29,25 @@ struct TCurveUnderlyingType
 	using Type = typename CurveUnderlyingType_Private::TCurveUnderlyingTypeImpl<typename TDecay<T>::Type>::Type;
 };
 
+/**
+ * A metadata property that has been resolved from a meta class once, so it can be read without looking it up by name.
+ * Handles stay safe to use if the layout changes, they just fall back to a lookup by name.
+ */
+USTRUCT(BlueprintType)
+struct FMetaSplinePropertyHandle
+{
+	GENERATED_BODY()
+
+	bool IsValid() const { return Slot != INDEX_NONE; }
+
+	UPROPERTY(BlueprintReadOnly, Category = "Spline|Metadata")
+	FName PropertyName;
+
+	// Index of the packed track among the tracks of the same type.
+	UPROPERTY()
+	int32 Slot = INDEX_NONE;
+};
+
 /**
  * Holds the actual curves that are generated from the meta class.
  */
@@ -45,81 +70,268 @@ public:
 	void UpdateMetadataClass(UClass* InClass);
 	bool HasValidMetadataClass() const { return MetaClass ? true : false; }
 
-	template<typename T> decltype(auto) FindCurve(const FName InName) const { return FindCurveMapForType<T>().Find(InName); }
-	template<typename T> decltype(auto) FindCurve(const FName InName) { return FindCurveMapForType<T>().Find(InName); }
+	EMetaSplineMetadataStorage GetStorage() const { return Storage; }
+
+	/**
+	 * Converts all curves to the given storage. Does nothing if the metadata already uses it.
+	 * Curve storage is kept if a curve has per point interpolation modes or user tangents, since packed tracks can't represent them.
+	 */
+	void SetStorage(EMetaSplineMetadataStorage InStorage);
+
+	/**
+	 * Replaces the packed storage with an identical, immutable payload used by other metadata, or makes it available to them.
+	 * The metadata makes a private copy the first time it is modified afterwards.
+	 */
+	void ShareStorage();
+	bool IsStorageShared() const { return SharedPacked.IsValid(); }
+
+	/**
+	 * Returns packed storage with the current values and tangents of all curves, that is never modified and can be read from any thread.
+	 * Shared storage is returned as is, otherwise it is copied, or converted from the curves.
+	 * Curves with per point interpolation modes or broken tangents are converted with the mode of their first point, and a warning.
+	 */
+	TSharedRef<const FMetaSplinePackedStorage, ESPMode::ThreadSafe> MakeImmutableStorage() const;
+
+	/**
+	 * Incremented whenever the values of the curves may have been modified, so anything derived from them can be cached.
+	 * Recomputing tangents or changing the loop state doesn't count as a modification.
+	 */
+	uint32 GetChangeCounter() const { return ChangeCounter; }
+
+	/**
+	 * Copies the curves and their state from another metadata object directly, without going through reflection.
+	 * Shared storage is shared rather than copied. Returns false, without modifying anything, if the content was already the same.
+	 */
+	bool CopyMetadataFrom(const UMetaSplineMetadata& InOther);
+
+	template<typename T> TMetaSplineCurveView<const T> FindCurve(const FName InName) const { return FindCurve_Implementation<const T>(this, InName); }
+	template<typename T> TMetaSplineCurveView<T> FindCurve(const FName InName) { return FindCurve_Implementation<T>(this, InName); }
+
+	template<typename T> TMetaSplineCurveView<const T> FindCurve(const FMetaSplinePropertyHandle& InHandle) const { return FindCurve_Implementation<const T>(this, InHandle); }
+	template<typename T> TMetaSplineCurveView<T> FindCurve(const FMetaSplinePropertyHandle& InHandle) { return FindCurve_Implementation<T>(this, InHandle); }
+
+	/** Resolves a property of a meta class to a handle, which is valid for all metadata using that class. */
+	static FMetaSplinePropertyHandle MakePropertyHandle(const UClass* InMetaClass, FName InProperty);
+
+	/**
+	 * Evaluates every property at InKey and writes the values to the properties with the same name and type in OutContainer.
+	 * The segment is only found once, since all curves share the same keys.
+	 */
+	bool EvaluateAllAtKey(float InKey, const UStruct* InContainerType, void* OutContainer) const;
+
+	/** Resamples the packed tracks into lookup tables, used instead of the curves until the metadata is modified. */
+	void BakeTracks(int32 InDefaultSamplesPerSegment);
+	void ClearBakedTracks();
+
+	/** Returns the largest difference between a baked lookup table and its source curve, over all tracks. */
+	float GetMaxBakeError() const;
+
+	virtual void Serialize(FArchive& Ar) override;
+	virtual void PostLoad() override;
 
 private:
-	template<typename T, typename F>
-	void TransformCurveMap(F&& Function)
+	template<typename T, typename TSelf>
+	static TMetaSplineCurveView<T> FindCurve_Implementation(TSelf* InSelf, const FName InName)
 	{
-		for (auto& Curve : FindCurveMapForType<T>())
+		using TValue = typename TRemoveConst<T>::Type;
+		if (InSelf->Storage == EMetaSplineMetadataStorage::Packed)
 		{
-			if constexpr (TIsInvocable<F, decltype(Curve.Value)>::Value)
-			{
-				Function(Curve.Value);
-			}
-			else if constexpr (TIsInvocable<F, decltype(Curve)>::Value)
+			auto& PackedStorage = GetPacked_Implementation(InSelf);
+			return { PackedStorage.template FindTrack<TValue>(InName), &PackedStorage };
+		}
+		return { InSelf->template FindCurveMapForType<TValue>().Find(InName) };
+	}
+
+	template<typename T, typename TSelf>
+	static TMetaSplineCurveView<T> FindCurve_Implementation(TSelf* InSelf, const FMetaSplinePropertyHandle& InHandle)
+	{
+		using TValue = typename TRemoveConst<T>::Type;
+		if (InSelf->Storage == EMetaSplineMetadataStorage::Packed)
+		{
+			auto& PackedStorage = GetPacked_Implementation(InSelf);
+			auto& Tracks = PackedStorage.template GetTracks<TValue>();
+			if (Tracks.IsValidIndex(InHandle.Slot) && Tracks[InHandle.Slot].Name == InHandle.PropertyName)
 			{
-				Function(Curve);
+				return { &Tracks[InHandle.Slot], &PackedStorage };
 			}
-			else if constexpr (TIsInvocable<F, decltype(Curve.Key), decltype(Curve.Value)>::Value)
+		}
+
+		// The handle is stale, or the storage doesn't support direct indexing.
+		return FindCurve_Implementation<T>(InSelf, InHandle.PropertyName);
+	}
+
+	template<typename F, typename TView>
+	static void InvokeOnCurve(F& Function, FName InName, TView& InView)
+	{
+		if constexpr (TIsInvocable<F, TView&>::Value)
+		{
+			Function(InView);
+		}
+		else if constexpr (TIsInvocable<F, FName, TView&>::Value)
+		{
+			Function(InName, InView);
+		}
+		else
+		{
+			static_assert(false, "Invalid function passed to UMetaSplineMetadata::TransformCurveMap()");
+		}
+	}
+
+	template<typename T, typename TSelf, typename F>
+	static void TransformCurveMap_Implementation(TSelf* InSelf, F& Function)
+	{
+		using TView = TMetaSplineCurveView<typename TChooseClass<TIsConst<TSelf>::Value, const T, T>::Result>;
+		if (InSelf->Storage == EMetaSplineMetadataStorage::Packed)
+		{
+			auto& PackedStorage = GetPacked_Implementation(InSelf);
+			for (auto& Track : PackedStorage.template GetTracks<T>())
 			{
-				Function(Curve.Key, Curve.Value);
+				TView View(&Track, &PackedStorage);
+				InvokeOnCurve(Function, Track.Name, View);
 			}
-			else
+		}
+		else
+		{
+			for (auto& Curve : InSelf->template FindCurveMapForType<T>())
 			{
-				static_assert(false, "Invalid function passed to UMetaSplineMetadata::TransformCurveMap()");
+				TView View(&Curve.Value);
+				InvokeOnCurve(Function, Curve.Key, View);
 			}
 		}
 	}
 
+	template<typename T, typename F> void TransformCurveMap(F&& Function) const { TransformCurveMap_Implementation<T>(this, Function); }
+	template<typename T, typename F> void TransformCurveMap(F&& Function) { TransformCurveMap_Implementation<T>(this, Function); }
+
 	template<typename F>
-	void TransformCurves(F&& Function)
+	void TransformCurves(F&& Function) const
 	{
-		TransformCurveMap<float>(Forward<F>(Function));
-		TransformCurveMap<FVector>(Forward<F>(Function));
+		ForEachMetaSplineType([this, &Function](auto Tag)
+		{
+			TransformCurveMap<typename decltype(Tag)::Type>(Function);
+		});
 	}
 
 	template<typename F>
-	void TransformPoints(int32 StartIndex, F&& Function)
+	void TransformCurves(F&& Function)
 	{
-		TransformCurves([=](auto& Curve)
+		ForEachMetaSplineType([this, &Function](auto Tag)
 		{
-			auto& Points = Curve.Points;
-			for (int32 i = StartIndex; i < Points.Num(); i++)
-			{
-				if constexpr (TIsInvocable<F, decltype(Points[i])>::Value)
-				{
-					Function(Points[i]);
-				}
-				else if constexpr (TIsInvocable<F, decltype(Points[i]), int32>::Value)
-				{
-					Function(Points[i], i);
-				}
-				else
-				{
-					static_assert(false, "Invalid function passed to UMetaSplineMetadata::TransformPoints()");
-				}
-			}
+			TransformCurveMap<typename decltype(Tag)::Type>(Function);
 		});
 	}
 
-	template<typename F>
-	void TransformPoints(F&& Function)
+	// Reads go to the shared payload if there is one. Writes make a private copy of it first.
+	const FMetaSplinePackedStorage& GetPacked() const { return SharedPacked.IsValid() ? *SharedPacked : Packed; }
+	FMetaSplinePackedStorage& GetMutablePacked();
+
+	template<typename TSelf>
+	static decltype(auto) GetPacked_Implementation(TSelf* InSelf)
 	{
-		TransformPoints(0, Forward<F>(Function));
+		if constexpr (TIsConst<TSelf>::Value) { return InSelf->GetPacked(); }
+		else { return InSelf->GetMutablePacked(); }
 	}
 
+	/** Updates the loop state of the packed storage, without making a private copy of a shared payload if it is unchanged. */
+	void SetPackedLoopState(bool bInIsLooped, float InLoopKeyOffset);
+
 	template<typename T, typename TSelf>
 	static decltype(auto) FindCurveMapForType_Implementation(TSelf* InSelf)
 	{
 		if constexpr (TIsSame<T, float>::Value) { return (InSelf->FloatCurves); }
 		else if constexpr (TIsSame<T, FVector>::Value) { return (InSelf->VectorCurves); }
+		else if constexpr (TIsSame<T, FQuat>::Value) { return (InSelf->QuatCurves); }
+		else if constexpr (TIsSame<T, FLinearColor>::Value) { return (InSelf->LinearColorCurves); }
+		else if constexpr (TIsSame<T, FVector2D>::Value) { return (InSelf->Vector2DCurves); }
 		else { static_assert(false, "Curve type not supported!"); }
 	}
 	template<typename T> decltype(auto) FindCurveMapForType() const { return FindCurveMapForType_Implementation<T>(this); }
 	template<typename T> decltype(auto) FindCurveMapForType() { return FindCurveMapForType_Implementation<T>(this); }
 
+	FMetaSplineSegment FindSegment(float InKey) const;
+
+	// All curves share the same loop state, so these are read from whichever storage is in use.
+	bool IsLooped() const;
+	float GetLoopKeyOffset() const;
+	void GetLoopState(bool& bOutIsLooped, float& OutLoopKeyOffset) const;
+
+#if WITH_EDITOR
+	/** Copies per property settings from meta tags on the meta class, since meta data isn't available in cooked builds. */
+	void UpdateTrackSettings();
+#endif
+
+	template<typename T>
+	void EvaluatePropertyAtSegment(const FMetaSplinePropertyLayout& InProperty, const FMetaSplineSegment& InSegment, float InKey, int32& InOutSlot, void* OutContainer) const;
+
+	// Curves taken out of the metadata while it changes meta class, so the ones that still match can be moved back.
+	struct FMigratedCurves
+	{
+		FMetaSplinePackedStorage Packed;
+		TMap<FName, FInterpCurveFloat> FloatCurves;
+		TMap<FName, FInterpCurveVector> VectorCurves;
+		TMap<FName, FInterpCurveQuat> QuatCurves;
+		TMap<FName, FInterpCurveLinearColor> LinearColorCurves;
+		TMap<FName, FInterpCurveVector2D> Vector2DCurves;
+	};
+
+	/** Writes or reads the packed tracks as a schema header and raw value blocks, which load much faster than tagged properties. */
+	void SerializeBinaryTracks(FArchive& Ar);
+
+	template<typename T> void AddCurve(FName InName, const T& InDefaultValue);
+	/** Returns true if there is exactly one curve for each supported property of InClass, where property handles expect it. */
+	bool MatchesLayout(const UClass* InClass) const;
+
+	template<typename T> bool ReclaimCurve(FName InName, FMigratedCurves& InOutPrevious);
+	/** Returns false, and warns once, if a curve in the curve maps has per point interpolation modes or user tangents. */
+	bool CanPackCurveMaps() const;
+
+	template<typename T> void MoveCurvesToTracks();
+	template<typename T> void MoveTracksToCurves();
+
+	void SetLoopKey(float InLoopKey);
+	void ClearLoopKey();
+
+	/** Recomputes the tangents around the points marked as dirty, or all of them if the loop state or settings changed. */
+	void AutoSetTangents(float InTension, bool bStationaryEndpoints);
+
+	/** Marks the values of the points in [InBegin, InEnd) as modified, so the tangents around them are recomputed by AutoSetTangents(). */
+	void MarkPointsDirty(int32 InBegin, int32 InEnd);
+	void MarkPointsDirty(int32 InIndex) { MarkPointsDirty(InIndex, InIndex + 1); }
+	void MarkAllPointsDirty() { ++ChangeCounter; bAllPointsDirty = true; }
+
+	/** Keeps the dirty range pointing at the same points after InDelta points were inserted or removed at InIndex. */
+	void ShiftDirtyPoints(int32 InIndex, int32 InDelta);
+
+	/** Brings the input keys of the curve storage up to date after points were inserted or removed. */
+	void RenumberStaleKeys();
+
+	/**
+	 * Records InStateHash as the state of the owning component the metadata is in sync with, if nothing is waiting to be recomputed.
+	 * Called before saving.
+	 */
+	void SaveCleanState(uint32 InStateHash, int32 InNumPoints, float InTension, bool bStationaryEndpoints);
+
+	/**
+	 * Restores what Fixup() and AutoSetTangents() would have computed, if the metadata was saved in sync with InStateHash.
+	 * Returns false if the metadata has to be synchronized.
+	 */
+	bool RestoreCleanState(uint32 InStateHash, int32 InNumPoints, float InTension, bool bStationaryEndpoints);
+
+	// Point edits are recorded for undo as the values of the affected point, see FMetaSplinePointChange.
+	bool IsRecordingPointChanges() const;
+	void RecordPointChange(EMetaSplinePointChange InType, int32 InIndex, FMetaSplinePointValues&& InBefore);
+	void CapturePoint(int32 InIndex, FMetaSplinePointValues& OutValues) const;
+	bool MatchesCurves(const FMetaSplinePointValues& InValues) const;
+
+	// Replays a recorded point edit. These don't record anything themselves.
+	void InsertPointValues(int32 InIndex, const FMetaSplinePointValues& InValues);
+	void RemovePointValues(int32 InIndex);
+	void SetPointValues(int32 InIndex, const FMetaSplinePointValues& InValues);
+
+	// Bulk writes to a single property are recorded as the written values only, see FMetaSplinePropertyChange.
+	void RecordPropertyChange(FName InProperty, TArray<int32>&& InIndices, FMetaSplinePointValues&& InBefore, FMetaSplinePointValues&& InAfter);
+	void SetPropertyValues(FName InProperty, const TArray<int32>& InIndices, const FMetaSplinePointValues& InValues);
+
 	virtual void PostTransacted(const FTransactionObjectEvent& TransactionEvent) override;
 
 private:
@@ -129,14 +341,68 @@ private:
 	UPROPERTY(EditAnywhere, Category = "Meta")
 	TMap<FName, FInterpCurveVector> VectorCurves;
 
+	UPROPERTY(EditAnywhere, Category = "Meta")
+	TMap<FName, FInterpCurveQuat> QuatCurves;
+
+	UPROPERTY(EditAnywhere, Category = "Meta")
+	TMap<FName, FInterpCurveLinearColor> LinearColorCurves;
+
+	UPROPERTY(EditAnywhere, Category = "Meta")
+	TMap<FName, FInterpCurveVector2D> Vector2DCurves;
+
+	// Private packed storage. Empty while SharedPacked is set.
+	UPROPERTY()
+	FMetaSplinePackedStorage Packed;
+
+	TSharedPtr<const FMetaSplinePackedStorage, ESPMode::ThreadSafe> SharedPacked;
+
+	// Bumped whenever points are marked dirty, which every write to the values does, see GetChangeCounter().
+	uint32 ChangeCounter = 0;
+
+	UPROPERTY()
+	EMetaSplineMetadataStorage Storage = EMetaSplineMetadataStorage::Packed;
+
 	UPROPERTY()
 	TSubclassOf<UObject> MetaClass;
 
 	int32 NumCurves = 0;
 	int32 NumPoints = 0;
 
+	struct FTangentSettings
+	{
+		bool bIsLooped = false;
+		float LoopKeyOffset = 0.0f;
+		float Tension = 0.0f;
+		bool bStationaryEndpoints = false;
+
+		bool operator==(const FTangentSettings& Other) const
+		{
+			return bIsLooped == Other.bIsLooped && LoopKeyOffset == Other.LoopKeyOffset && Tension == Other.Tension && bStationaryEndpoints == Other.bStationaryEndpoints;
+		}
+	};
+
+	// The settings the tangents were last computed with. All tangents are recomputed when they change.
+	TOptional<FTangentSettings> TangentSettings;
+
+	// Points whose values were modified since the tangents were last computed.
+	int32 DirtyBegin = 0;
+	int32 DirtyEnd = 0;
+	bool bAllPointsDirty = true;
+
+	// First point whose input key in the curve storage no longer matches its index. Nothing older than this is stale.
+	int32 StaleKeysFrom = 0;
+
+	// Hash of the owning component state when saved in sync with it, or zero. Only serialized to and from packages.
+	uint32 CleanStateHash = 0;
+
+	// Curves that packed tracks can't represent are only reported once per object, since conversion is retried on every sync.
+	mutable bool bWarnedUnpackableCurves = false;
+
 	friend class FMetaSplineMetadataDetails;
 	friend class FMetaSplineDebugRenderer;
 	friend class UMetaSplineComponent;
+	friend class FMetaSplinePointChange;
+	friend class FMetaSplinePropertyChange;
 	template<typename T> friend struct FAddCurve;
+	template<typename T> friend struct FUpdateMetadata;
 };
@@ -18,6 +18,21 @@ public:
 	//~ UDeveloperSettings interface
 	virtual FText GetSectionText() const override;
 #endif
+
+	/** Samples per spline segment when baking metadata to lookup tables. Properties can override it with the MetaSplineBakeSamples meta tag. */
+	UPROPERTY(config, EditAnywhere, Category = "Baking", meta = (ClampMin = 1))
+	int32 BakeSamplesPerSegment = 8;
+
+	/** Lets splines with identical metadata share a single copy of it. A spline gets its own copy the first time its metadata is modified. */
+	UPROPERTY(config, EditAnywhere, Category = "Memory")
+	bool bShareIdenticalMetadata = true;
+
+	/**
+	 * Reruns construction scripts once on the next tick after metadata is modified by undo or redo, instead of once per modified object.
+	 * Disable to have the construction script see the change immediately.
+	 */
+	UPROPERTY(config, EditAnywhere, Category = "Editor")
+	bool bDeferConstructionScriptReruns = true;
 };
 
 UCLASS(config = EditorPerProjectUserSettings, defaultconfig)
@@ -36,4 +51,8 @@ public:
 	/** The number of points to draw. -1 means draw all points. */
 	UPROPERTY(config, EditAnywhere, Category = "Debug")
 	int32 NumberOfPoints = -1;
+
+	/** Points farther away from the camera than this are not drawn. 0 means no limit. */
+	UPROPERTY(config, EditAnywhere, Category = "Debug", meta = (ClampMin = 0, Units = "cm"))
+	float MaxDistance = 0.0f;
 };
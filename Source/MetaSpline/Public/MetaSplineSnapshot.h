@@ -0,0 +1,89 @@
+// Copyright(c) 2021 Viktor Pramberg
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MetaSplineComponent.h"
+#include "MetaSplineTrack.h"
+
+/**
+ * An immutable copy of the spline and metadata of a UMetaSplineComponent, published by the component whenever the metadata is synchronized.
+ * Nothing in a snapshot is ever modified, so it can be sampled from any thread for as long as a reference to it is held.
+ * The sampling functions match the ones on the component.
+ */
+class METASPLINE_API FMetaSplineSnapshot
+{
+public:
+	int32 GetNumberOfSplinePoints() const;
+	float GetSplineLength() const;
+	const FTransform& GetComponentTransform() const { return ComponentTransform; }
+
+	FVector GetLocationAtSplineInputKey(float InKey, ESplineCoordinateSpace::Type InCoordinateSpace) const;
+	FVector GetLocationAtDistanceAlongSpline(float InDistance, ESplineCoordinateSpace::Type InCoordinateSpace) const;
+
+	// -- Metadata accessors --
+	float GetMetadataFloatAtPoint(FName InProperty, int32 InIndex) const;
+	FVector GetMetadataVectorAtPoint(FName InProperty, int32 InIndex) const;
+	float GetMetadataFloatAtKey(FName InProperty, float InKey) const;
+	FVector GetMetadataVectorAtKey(FName InProperty, float InKey) const;
+	FRotator GetMetadataRotatorAtPoint(FName InProperty, int32 InIndex) const;
+	FRotator GetMetadataRotatorAtKey(FName InProperty, float InKey) const;
+	FLinearColor GetMetadataColorAtPoint(FName InProperty, int32 InIndex) const;
+	FLinearColor GetMetadataColorAtKey(FName InProperty, float InKey) const;
+	FVector2D GetMetadataVector2DAtPoint(FName InProperty, int32 InIndex) const;
+	FVector2D GetMetadataVector2DAtKey(FName InProperty, float InKey) const;
+
+	template<typename T, typename TProperty>
+	T GetMetadataAtKey(const TProperty& InProperty, float InKey) const
+	{
+		if (const auto Curve = FindCurve<T>(InProperty))
+		{
+			return Curve->Eval(InKey);
+		}
+		return T(ForceInit);
+	}
+
+	// -- Handle based metadata accessors --
+	float GetMetadataFloatAtPoint(const FMetaSplinePropertyHandle& InHandle, int32 InIndex) const;
+	FVector GetMetadataVectorAtPoint(const FMetaSplinePropertyHandle& InHandle, int32 InIndex) const;
+	float GetMetadataFloatAtKey(const FMetaSplinePropertyHandle& InHandle, float InKey) const;
+	FVector GetMetadataVectorAtKey(const FMetaSplinePropertyHandle& InHandle, float InKey) const;
+
+	// -- Distance based metadata accessors --
+	float GetMetadataFloatAtDistance(FName InProperty, float InDistance) const;
+	FVector GetMetadataVectorAtDistance(FName InProperty, float InDistance) const;
+	float GetMetadataFloatAtDistance(const FMetaSplinePropertyHandle& InHandle, float InDistance) const;
+	FVector GetMetadataVectorAtDistance(const FMetaSplinePropertyHandle& InHandle, float InDistance) const;
+
+	/** Same as UMetaSplineComponent::GetMetadataKeyAtDistance(). */
+	float GetMetadataKeyAtDistance(float InDistance) const;
+
+	template<typename T> TMetaSplineCurveView<const T> FindCurve(const FName InName) const { return { Storage->FindTrack<T>(InName), &Storage.Get() }; }
+	template<typename T> TMetaSplineCurveView<const T> FindCurve(const FMetaSplinePropertyHandle& InHandle) const
+	{
+		const auto& Tracks = Storage->GetTracks<T>();
+		if (Tracks.IsValidIndex(InHandle.Slot) && Tracks[InHandle.Slot].Name == InHandle.PropertyName)
+		{
+			return { &Tracks[InHandle.Slot], &Storage.Get() };
+		}
+		return FindCurve<T>(InHandle.PropertyName);
+	}
+
+private:
+	// The spline itself, which is shared between snapshots that only differ in their transform.
+	struct FSplineData
+	{
+		FSplineCurves SplineCurves;
+		FMetaSplineDistanceIndex DistanceIndex;
+	};
+
+	FMetaSplineSnapshot(const TSharedRef<const FSplineData, ESPMode::ThreadSafe>& InSplineData, const TSharedRef<const FMetaSplinePackedStorage, ESPMode::ThreadSafe>& InStorage, const FTransform& InComponentTransform)
+		: SplineData(InSplineData), Storage(InStorage), ComponentTransform(InComponentTransform)
+	{
+	}
+
+	const TSharedRef<const FSplineData, ESPMode::ThreadSafe> SplineData;
+	const TSharedRef<const FMetaSplinePackedStorage, ESPMode::ThreadSafe> Storage;
+	const FTransform ComponentTransform;
+
+	friend class UMetaSplineComponent;
+};
@@ -0,0 +1,68 @@
+// Copyright(c) 2021 Viktor Pramberg
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "MetaSplineSubsystem.generated.h"
+
+class UMetaSplineComponent;
+
+/**
+ * Keeps track of the registered MetaSpline components of a world, so they can be found without iterating over every object.
+ * Components are organized in a bounding volume hierarchy, rebuilt lazily when a component is added or removed.
+ * Moved components only refit the nodes above them, until enough have moved that the hierarchy is worth rebuilding.
+ */
+UCLASS()
+class METASPLINE_API UMetaSplineSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	static UMetaSplineSubsystem* Get(const UWorld* InWorld) { return InWorld ? InWorld->GetSubsystem<UMetaSplineSubsystem>() : nullptr; }
+
+	void RegisterComponent(UMetaSplineComponent* InComponent);
+	void UnregisterComponent(UMetaSplineComponent* InComponent);
+
+	/** Call when the bounds of a registered component changed. */
+	void MarkBoundsDirty(const UMetaSplineComponent* InComponent);
+
+	const TArray<UMetaSplineComponent*>& GetComponents() const { return Components; }
+
+	/** Appends the components whose bounds intersect InFrustum. */
+	void GetComponentsInFrustum(const FConvexVolume& InFrustum, TArray<UMetaSplineComponent*>& OutComponents);
+
+private:
+	void BuildHierarchy();
+	int32 BuildNode(int32 InBegin, int32 InEnd, int32 InParent);
+
+	/** Updates the bounds of the moved components, and of every node above them. */
+	void RefitHierarchy();
+
+	struct FNode
+	{
+		FBox Bounds;
+
+		// Leaves reference a range of ElementOrder, inner nodes their two children.
+		int32 First = INDEX_NONE;
+		int32 Count = 0;
+		int32 Children[2] = { INDEX_NONE, INDEX_NONE };
+		int32 Parent = INDEX_NONE;
+	};
+
+	UPROPERTY(Transient)
+	TArray<UMetaSplineComponent*> Components;
+
+	TArray<FNode> Nodes;
+	TArray<FBox> ElementBounds;
+	TArray<int32> ElementOrder;
+	bool bHierarchyDirty = true;
+
+	// The leaf of each component, and the components that moved since the hierarchy was last refit.
+	// Components are only used as keys here, so the map doesn't keep them alive.
+	TMap<const UMetaSplineComponent*, int32> ElementIndices;
+	TArray<int32> ElementLeaves;
+	TArray<int32> MovedElements;
+
+	// Refitting loosens the hierarchy, so it is rebuilt once as many elements were refit as there are components.
+	int32 NumRefitElements = 0;
+};
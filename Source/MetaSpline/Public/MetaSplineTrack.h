@@ -0,0 +1,908 @@
+// Copyright(c) 2021 Viktor Pramberg
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MetaSplineTrack.generated.h"
+
+/**
+ * How the metadata curves of a UMetaSplineMetadata are stored.
+ */
+UENUM()
+enum class EMetaSplineMetadataStorage : uint8
+{
+	/** One FInterpCurve per property, stored in a map. This is how metadata was stored originally. */
+	Curves,
+
+	/** One contiguous value array per property, indexed by a dense slot. Input keys are implicit from the point index. */
+	Packed,
+};
+
+/**
+ * Lossy encodings for the values of packed tracks in cooked data. Tracks are decoded on load, and their tangents rebuilt.
+ * Set per property with the MetaSplineCompression meta tag, e.g. meta = (MetaSplineCompression = "Half").
+ */
+UENUM()
+enum class EMetaSplineCompression : uint8
+{
+	None,
+
+	/** 16 bit floats. */
+	Half,
+
+	/** 16 bits per component, spread evenly between the smallest and largest value of the component. */
+	FixedPoint,
+
+	/** The first value, followed by 16 bit differences between neighbouring points. Suits smoothly changing values with a large range. */
+	Delta,
+};
+
+/**
+ * Packed metadata for a single float property.
+ */
+USTRUCT()
+struct FMetaSplineFloatTrack
+{
+	GENERATED_BODY()
+
+	using ValueType = float;
+
+	UPROPERTY()
+	FName Name;
+
+	UPROPERTY()
+	TArray<float> Values;
+
+	// Parallel to Values. Only populated for curve interpolation modes, since linear and constant segments never read tangents.
+	UPROPERTY()
+	TArray<float> Tangents;
+
+	// Overridden by the MetaSplineInterpMode meta tag. Only CurveAuto and CurveAutoClamped tracks have tangents, and are worth baking.
+	UPROPERTY()
+	TEnumAsByte<EInterpCurveMode> InterpMode = CIM_Linear;
+
+	// Lookup table resolution when baked, from the MetaSplineBakeSamples meta tag. Zero uses the project default.
+	UPROPERTY()
+	int32 BakeSamplesPerSegment = 0;
+
+	// How the values are stored in cooked data, from the MetaSplineCompression meta tag.
+	UPROPERTY()
+	EMetaSplineCompression Compression = EMetaSplineCompression::None;
+
+	// Uniformly resampled values that replace curve evaluation when baked. Rebuilt on load, and cleared by any modification.
+	TArray<float> Baked;
+	float BakedInvStep = 0.0f;
+};
+
+/**
+ * Packed metadata for a single vector property.
+ */
+USTRUCT()
+struct FMetaSplineVectorTrack
+{
+	GENERATED_BODY()
+
+	using ValueType = FVector;
+
+	UPROPERTY()
+	FName Name;
+
+	UPROPERTY()
+	TArray<FVector> Values;
+
+	// Parallel to Values. Only populated for curve interpolation modes, since linear and constant segments never read tangents.
+	UPROPERTY()
+	TArray<FVector> Tangents;
+
+	// Overridden by the MetaSplineInterpMode meta tag. Only CurveAuto and CurveAutoClamped tracks have tangents, and are worth baking.
+	UPROPERTY()
+	TEnumAsByte<EInterpCurveMode> InterpMode = CIM_Linear;
+
+	// Lookup table resolution when baked, from the MetaSplineBakeSamples meta tag. Zero uses the project default.
+	UPROPERTY()
+	int32 BakeSamplesPerSegment = 0;
+
+	// How the values are stored in cooked data, from the MetaSplineCompression meta tag.
+	UPROPERTY()
+	EMetaSplineCompression Compression = EMetaSplineCompression::None;
+
+	// Uniformly resampled values that replace curve evaluation when baked. Rebuilt on load, and cleared by any modification.
+	TArray<FVector> Baked;
+	float BakedInvStep = 0.0f;
+};
+
+/**
+ * Packed metadata for a single quaternion property.
+ */
+USTRUCT()
+struct FMetaSplineQuatTrack
+{
+	GENERATED_BODY()
+
+	using ValueType = FQuat;
+
+	UPROPERTY()
+	FName Name;
+
+	UPROPERTY()
+	TArray<FQuat> Values;
+
+	// Parallel to Values. Only populated for curve interpolation modes, since linear and constant segments never read tangents.
+	UPROPERTY()
+	TArray<FQuat> Tangents;
+
+	// Overridden by the MetaSplineInterpMode meta tag. Only CurveAuto and CurveAutoClamped tracks have tangents, and are worth baking.
+	UPROPERTY()
+	TEnumAsByte<EInterpCurveMode> InterpMode = CIM_Linear;
+
+	// Lookup table resolution when baked, from the MetaSplineBakeSamples meta tag. Zero uses the project default.
+	UPROPERTY()
+	int32 BakeSamplesPerSegment = 0;
+
+	// How the values are stored in cooked data, from the MetaSplineCompression meta tag.
+	UPROPERTY()
+	EMetaSplineCompression Compression = EMetaSplineCompression::None;
+
+	// Uniformly resampled values that replace curve evaluation when baked. Rebuilt on load, and cleared by any modification.
+	TArray<FQuat> Baked;
+	float BakedInvStep = 0.0f;
+};
+
+/**
+ * Packed metadata for a single linear color property.
+ */
+USTRUCT()
+struct FMetaSplineLinearColorTrack
+{
+	GENERATED_BODY()
+
+	using ValueType = FLinearColor;
+
+	UPROPERTY()
+	FName Name;
+
+	UPROPERTY()
+	TArray<FLinearColor> Values;
+
+	// Parallel to Values. Only populated for curve interpolation modes, since linear and constant segments never read tangents.
+	UPROPERTY()
+	TArray<FLinearColor> Tangents;
+
+	// Overridden by the MetaSplineInterpMode meta tag. Only CurveAuto and CurveAutoClamped tracks have tangents, and are worth baking.
+	UPROPERTY()
+	TEnumAsByte<EInterpCurveMode> InterpMode = CIM_Linear;
+
+	// Lookup table resolution when baked, from the MetaSplineBakeSamples meta tag. Zero uses the project default.
+	UPROPERTY()
+	int32 BakeSamplesPerSegment = 0;
+
+	// How the values are stored in cooked data, from the MetaSplineCompression meta tag.
+	UPROPERTY()
+	EMetaSplineCompression Compression = EMetaSplineCompression::None;
+
+	// Uniformly resampled values that replace curve evaluation when baked. Rebuilt on load, and cleared by any modification.
+	TArray<FLinearColor> Baked;
+	float BakedInvStep = 0.0f;
+};
+
+/**
+ * Packed metadata for a single 2D vector property.
+ */
+USTRUCT()
+struct FMetaSplineVector2DTrack
+{
+	GENERATED_BODY()
+
+	using ValueType = FVector2D;
+
+	UPROPERTY()
+	FName Name;
+
+	UPROPERTY()
+	TArray<FVector2D> Values;
+
+	// Parallel to Values. Only populated for curve interpolation modes, since linear and constant segments never read tangents.
+	UPROPERTY()
+	TArray<FVector2D> Tangents;
+
+	// Overridden by the MetaSplineInterpMode meta tag. Only CurveAuto and CurveAutoClamped tracks have tangents, and are worth baking.
+	UPROPERTY()
+	TEnumAsByte<EInterpCurveMode> InterpMode = CIM_Linear;
+
+	// Lookup table resolution when baked, from the MetaSplineBakeSamples meta tag. Zero uses the project default.
+	UPROPERTY()
+	int32 BakeSamplesPerSegment = 0;
+
+	// How the values are stored in cooked data, from the MetaSplineCompression meta tag.
+	UPROPERTY()
+	EMetaSplineCompression Compression = EMetaSplineCompression::None;
+
+	// Uniformly resampled values that replace curve evaluation when baked. Rebuilt on load, and cleared by any modification.
+	TArray<FVector2D> Baked;
+	float BakedInvStep = 0.0f;
+};
+
+template<typename T> struct TMetaSplineTrackType { using Type = void; };
+template<> struct TMetaSplineTrackType<float> { using Type = FMetaSplineFloatTrack; };
+template<> struct TMetaSplineTrackType<FVector> { using Type = FMetaSplineVectorTrack; };
+template<> struct TMetaSplineTrackType<FQuat> { using Type = FMetaSplineQuatTrack; };
+template<> struct TMetaSplineTrackType<FLinearColor> { using Type = FMetaSplineLinearColorTrack; };
+template<> struct TMetaSplineTrackType<FVector2D> { using Type = FMetaSplineVector2DTrack; };
+
+/**
+ * The value types metadata properties can have. The order matches ForEachMetaSplineType().
+ */
+enum class EMetaSplinePropertyType : uint8
+{
+	Float,
+	Vector,
+	Quat,
+	LinearColor,
+	Vector2D,
+
+	Num,
+	Unsupported = Num,
+};
+
+template<typename T> struct TMetaSplinePropertyType { static constexpr EMetaSplinePropertyType Value = EMetaSplinePropertyType::Unsupported; };
+template<> struct TMetaSplinePropertyType<float> { static constexpr EMetaSplinePropertyType Value = EMetaSplinePropertyType::Float; };
+template<> struct TMetaSplinePropertyType<FVector> { static constexpr EMetaSplinePropertyType Value = EMetaSplinePropertyType::Vector; };
+template<> struct TMetaSplinePropertyType<FQuat> { static constexpr EMetaSplinePropertyType Value = EMetaSplinePropertyType::Quat; };
+template<> struct TMetaSplinePropertyType<FLinearColor> { static constexpr EMetaSplinePropertyType Value = EMetaSplinePropertyType::LinearColor; };
+template<> struct TMetaSplinePropertyType<FVector2D> { static constexpr EMetaSplinePropertyType Value = EMetaSplinePropertyType::Vector2D; };
+
+template<typename T> struct TMetaSplineTypeTag { using Type = T; };
+
+/** Calls Function with a TMetaSplineTypeTag for every value type metadata properties can have. */
+template<typename F>
+void ForEachMetaSplineType(F&& Function)
+{
+	Function(TMetaSplineTypeTag<float>());
+	Function(TMetaSplineTypeTag<FVector>());
+	Function(TMetaSplineTypeTag<FQuat>());
+	Function(TMetaSplineTypeTag<FLinearColor>());
+	Function(TMetaSplineTypeTag<FVector2D>());
+}
+
+/**
+ * Structure-of-arrays storage for all metadata properties of a spline.
+ * Every track shares the same point count and loop state, so that is only stored once.
+ */
+USTRUCT()
+struct FMetaSplinePackedStorage
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<FMetaSplineFloatTrack> FloatTracks;
+
+	UPROPERTY()
+	TArray<FMetaSplineVectorTrack> VectorTracks;
+
+	UPROPERTY()
+	TArray<FMetaSplineQuatTrack> QuatTracks;
+
+	UPROPERTY()
+	TArray<FMetaSplineLinearColorTrack> LinearColorTracks;
+
+	UPROPERTY()
+	TArray<FMetaSplineVector2DTrack> Vector2DTracks;
+
+	UPROPERTY()
+	bool bIsLooped = false;
+
+	UPROPERTY()
+	float LoopKeyOffset = 0.0f;
+
+	template<typename T> decltype(auto) GetTracks() const { return GetTracks_Implementation<T>(this); }
+	template<typename T> decltype(auto) GetTracks() { return GetTracks_Implementation<T>(this); }
+
+	template<typename T> decltype(auto) FindTrack(const FName InName) const { return GetTracks<T>().FindByPredicate([InName](const auto& Track) { return Track.Name == InName; }); }
+	template<typename T> decltype(auto) FindTrack(const FName InName) { return GetTracks<T>().FindByPredicate([InName](const auto& Track) { return Track.Name == InName; }); }
+
+	/** Hash of the names and values of the tracks and the loop state, for finding storage with the same content. */
+	uint32 GetContentHash() const
+	{
+		uint32 Hash = HashCombine(GetTypeHash(bIsLooped), GetTypeHash(LoopKeyOffset));
+		ForEachMetaSplineType([this, &Hash](auto Tag)
+		{
+			using T = typename decltype(Tag)::Type;
+			for (const auto& Track : GetTracks<T>())
+			{
+				Hash = HashCombine(Hash, GetTypeHash(Track.Name));
+				Hash = FCrc::MemCrc32(Track.Values.GetData(), Track.Values.Num() * sizeof(T), Hash);
+			}
+		});
+		return Hash;
+	}
+
+	/** Compares everything, including tangents and lookup tables, since storage with the same content can be used in place of this. */
+	bool HasSameContent(const FMetaSplinePackedStorage& Other) const
+	{
+		if (bIsLooped != Other.bIsLooped || LoopKeyOffset != Other.LoopKeyOffset)
+		{
+			return false;
+		}
+
+		bool bIsSame = true;
+		ForEachMetaSplineType([this, &Other, &bIsSame](auto Tag)
+		{
+			using T = typename decltype(Tag)::Type;
+			const auto& Tracks = GetTracks<T>();
+			const auto& OtherTracks = Other.GetTracks<T>();
+			if (!bIsSame || Tracks.Num() != OtherTracks.Num())
+			{
+				bIsSame = false;
+				return;
+			}
+
+			for (int32 i = 0; i < Tracks.Num() && bIsSame; i++)
+			{
+				const auto& A = Tracks[i];
+				const auto& B = OtherTracks[i];
+				bIsSame = A.Name == B.Name && A.InterpMode == B.InterpMode && A.BakeSamplesPerSegment == B.BakeSamplesPerSegment && A.Compression == B.Compression &&
+					A.Values == B.Values && A.Tangents == B.Tangents && A.Baked == B.Baked && A.BakedInvStep == B.BakedInvStep;
+			}
+		});
+		return bIsSame;
+	}
+
+	void Empty()
+	{
+		FloatTracks.Empty();
+		VectorTracks.Empty();
+		QuatTracks.Empty();
+		LinearColorTracks.Empty();
+		Vector2DTracks.Empty();
+	}
+
+private:
+	template<typename T, typename TSelf>
+	static decltype(auto) GetTracks_Implementation(TSelf* InSelf)
+	{
+		if constexpr (TIsSame<T, float>::Value) { return (InSelf->FloatTracks); }
+		else if constexpr (TIsSame<T, FVector>::Value) { return (InSelf->VectorTracks); }
+		else if constexpr (TIsSame<T, FQuat>::Value) { return (InSelf->QuatTracks); }
+		else if constexpr (TIsSame<T, FLinearColor>::Value) { return (InSelf->LinearColorTracks); }
+		else if constexpr (TIsSame<T, FVector2D>::Value) { return (InSelf->Vector2DTracks); }
+		else { static_assert(false, "Track type not supported!"); }
+	}
+};
+
+/**
+ * The segment an input key falls into. Metadata keys always match the point index, so finding a segment never requires a search.
+ */
+struct FMetaSplineSegment
+{
+	int32 Index = INDEX_NONE;
+	int32 NextIndex = INDEX_NONE;
+	float Alpha = 0.0f;
+
+	// The key this segment was found for.
+	float Key = 0.0f;
+
+	// Input key distance between Index and NextIndex. Zero if the key is clamped to a single point.
+	float Diff = 0.0f;
+
+	bool IsValid() const { return Index != INDEX_NONE; }
+
+	/** Mirrors the segment selection of FInterpCurve::Eval(), for curves where point i has the input key i. */
+	static FMetaSplineSegment Find(float InKey, int32 InNumPoints, bool bInIsLooped, float InLoopKeyOffset)
+	{
+		FMetaSplineSegment Segment;
+		Segment.Key = InKey;
+		if (InNumPoints <= 0)
+		{
+			return Segment;
+		}
+
+		const int32 LastPoint = InNumPoints - 1;
+		if (InKey < 0.0f)
+		{
+			Segment.Index = Segment.NextIndex = 0;
+			return Segment;
+		}
+
+		Segment.Index = InKey >= LastPoint ? LastPoint : FMath::FloorToInt(InKey);
+		if (Segment.Index == LastPoint)
+		{
+			if (!bInIsLooped)
+			{
+				Segment.NextIndex = LastPoint;
+				return Segment;
+			}
+			else if (InKey >= LastPoint + InLoopKeyOffset)
+			{
+				Segment.Index = Segment.NextIndex = 0;
+				return Segment;
+			}
+
+			Segment.NextIndex = 0;
+			Segment.Diff = InLoopKeyOffset;
+		}
+		else
+		{
+			Segment.NextIndex = Segment.Index + 1;
+			Segment.Diff = 1.0f;
+		}
+
+		Segment.Alpha = Segment.Diff > 0.0f ? (InKey - Segment.Index) / Segment.Diff : 0.0f;
+		return Segment;
+	}
+
+	/** Interpolates between two points the same way FInterpCurve::Eval() does. */
+	template<typename T>
+	T Interpolate(EInterpCurveMode InMode, const T& InPrev, const T& InNext, const T& InPrevLeaveTangent, const T& InNextArriveTangent) const
+	{
+		if (Diff > 0.0f && InMode != CIM_Constant)
+		{
+			if (InMode == CIM_Linear)
+			{
+				return FMath::Lerp(InPrev, InNext, Alpha);
+			}
+			return FMath::CubicInterp(InPrev, InPrevLeaveTangent * Diff, InNext, InNextArriveTangent * Diff, Alpha);
+		}
+		return InPrev;
+	}
+};
+
+/**
+ * A reference to the metadata of a single property, regardless of which storage the owning metadata uses.
+ * Behaves like a pointer, so it can be null-checked and used with operator->.
+ */
+template<typename T>
+class TMetaSplineCurveView
+{
+public:
+	using ValueType = typename TRemoveConst<T>::Type;
+	using CurveType = typename TChooseClass<TIsConst<T>::Value, const FInterpCurve<ValueType>, FInterpCurve<ValueType>>::Result;
+	using TrackType = typename TChooseClass<TIsConst<T>::Value, const typename TMetaSplineTrackType<ValueType>::Type, typename TMetaSplineTrackType<ValueType>::Type>::Result;
+	using StorageType = typename TChooseClass<TIsConst<T>::Value, const FMetaSplinePackedStorage, FMetaSplinePackedStorage>::Result;
+
+	TMetaSplineCurveView() = default;
+	TMetaSplineCurveView(CurveType* InCurve) : Curve(InCurve) {}
+	TMetaSplineCurveView(TrackType* InTrack, StorageType* InStorage) : Track(InTrack), Storage(InTrack ? InStorage : nullptr) {}
+
+	explicit operator bool() const { return Curve || Track; }
+	const TMetaSplineCurveView* operator->() const { return this; }
+
+	CurveType* GetCurve() const { return Curve; }
+	TrackType* GetTrack() const { return Track; }
+
+	int32 Num() const { return Curve ? Curve->Points.Num() : Track->Values.Num(); }
+
+	ValueType GetValue(int32 Index) const { return Curve ? Curve->Points[Index].OutVal : Track->Values[Index]; }
+
+	EInterpCurveMode GetInterpMode(int32 Index) const { return Curve ? Curve->Points[Index].InterpMode.GetValue() : Track->InterpMode.GetValue(); }
+
+	ValueType GetArriveTangent(int32 Index) const
+	{
+		if (Curve)
+		{
+			return Curve->Points[Index].ArriveTangent;
+		}
+		return Track->Tangents.IsValidIndex(Index) ? Track->Tangents[Index] : ValueType(ForceInit);
+	}
+
+	ValueType GetLeaveTangent(int32 Index) const
+	{
+		if (Curve)
+		{
+			return Curve->Points[Index].LeaveTangent;
+		}
+		return Track->Tangents.IsValidIndex(Index) ? Track->Tangents[Index] : ValueType(ForceInit);
+	}
+
+	bool IsLooped() const { return Curve ? Curve->bIsLooped : Storage->bIsLooped; }
+	float GetLoopKeyOffset() const { return Curve ? Curve->LoopKeyOffset : Storage->LoopKeyOffset; }
+
+	ValueType Eval(float InKey, const ValueType& Default = ValueType(ForceInit)) const
+	{
+		if (Curve)
+		{
+			return Curve->Eval(InKey, Default);
+		}
+
+		const FMetaSplineSegment Segment = FMetaSplineSegment::Find(InKey, Num(), IsLooped(), GetLoopKeyOffset());
+		return Segment.IsValid() ? Eval(Segment) : Default;
+	}
+
+	/** Evaluates an already resolved segment. The segment must be valid for this curve. */
+	ValueType Eval(const FMetaSplineSegment& InSegment) const
+	{
+		if (IsBaked())
+		{
+			return EvalBaked(*Track, InSegment.Key);
+		}
+
+		return InSegment.Interpolate(GetInterpMode(InSegment.Index),
+			GetValue(InSegment.Index), GetValue(InSegment.NextIndex),
+			GetLeaveTangent(InSegment.Index), GetArriveTangent(InSegment.NextIndex));
+	}
+
+	// -- Baking --
+	bool IsBaked() const { return Track && Track->Baked.Num() >= 2; }
+
+	/** Samples a baked lookup table with an index and a lerp. */
+	template<typename TTrack>
+	static typename TTrack::ValueType EvalBaked(const TTrack& InTrack, float InKey)
+	{
+		const int32 LastSample = InTrack.Baked.Num() - 1;
+		const float Sample = FMath::Clamp(InKey * InTrack.BakedInvStep, 0.0f, static_cast<float>(LastSample));
+		const int32 Index = FMath::Min(FMath::FloorToInt(Sample), LastSample - 1);
+		return FMath::Lerp(InTrack.Baked[Index], InTrack.Baked[Index + 1], Sample - Index);
+	}
+
+	/** The size of the lookup table Bake() creates, or zero if the curve isn't worth baking. */
+	int32 GetNumBakeSamples(int32 InSamplesPerSegment) const
+	{
+		if (!Track)
+		{
+			return 0;
+		}
+
+		const float EndKey = (Num() - 1) + (IsLooped() ? GetLoopKeyOffset() : 0.0f);
+		if (Track->InterpMode == CIM_Linear || Track->InterpMode == CIM_Constant || EndKey <= 0.0f || InSamplesPerSegment <= 0)
+		{
+			return 0;
+		}
+		return FMath::Max(FMath::CeilToInt(EndKey * InSamplesPerSegment) + 1, 2);
+	}
+
+	/**
+	 * Resamples the curve into a lookup table with InSamplesPerSegment samples per segment.
+	 * Only curves that interpolate with tangents are baked. Linear and constant curves already evaluate with an index and a lerp.
+	 */
+	void Bake(int32 InSamplesPerSegment) const
+	{
+		static_assert(!TIsConst<T>::Value, "Can't modify a const curve view");
+		if (!Track)
+		{
+			return;
+		}
+
+		Track->Baked.Reset();
+		Track->BakedInvStep = 0.0f;
+
+		const int32 NumSamples = GetNumBakeSamples(InSamplesPerSegment);
+		if (NumSamples == 0)
+		{
+			return;
+		}
+
+		const float EndKey = (Num() - 1) + (IsLooped() ? GetLoopKeyOffset() : 0.0f);
+		const float Step = EndKey / (NumSamples - 1);
+
+		TArray<ValueType> Baked;
+		Baked.SetNumUninitialized(NumSamples);
+		for (int32 i = 0; i < NumSamples; i++)
+		{
+			Baked[i] = Eval(i * Step);
+		}
+
+		Track->Baked = MoveTemp(Baked);
+		Track->BakedInvStep = 1.0f / Step;
+	}
+
+	/** Returns the largest difference between the baked lookup table and the curve it was baked from. */
+	float GetMaxBakeError(int32 InSubSamples = 4) const
+	{
+		// A table needs two samples to have anything to check between them.
+		if (!IsBaked() || Track->Baked.Num() < 2 || Num() == 0)
+		{
+			return 0.0f;
+		}
+
+		auto Distance = [](const ValueType& A, const ValueType& B)
+		{
+			if constexpr (TIsArithmetic<ValueType>::Value) { return FMath::Abs(A - B); }
+			else if constexpr (TIsSame<ValueType, FLinearColor>::Value) { return FLinearColor::Dist(A, B); }
+			else if constexpr (TIsSame<ValueType, FQuat>::Value) { return A.AngularDistance(B); }
+			else { return (A - B).Size(); }
+		};
+
+		const int32 NumPoints = Num();
+		const float EndKey = (NumPoints - 1) + (IsLooped() ? GetLoopKeyOffset() : 0.0f);
+		const int32 NumChecks = (Track->Baked.Num() - 1) * FMath::Max(InSubSamples, 1);
+
+		float MaxError = 0.0f;
+		for (int32 i = 0; i <= NumChecks; i++)
+		{
+			const float Key = EndKey * i / NumChecks;
+			const FMetaSplineSegment Segment = FMetaSplineSegment::Find(Key, NumPoints, IsLooped(), GetLoopKeyOffset());
+			const ValueType Exact = Segment.Interpolate(GetInterpMode(Segment.Index),
+				GetValue(Segment.Index), GetValue(Segment.NextIndex),
+				GetLeaveTangent(Segment.Index), GetArriveTangent(Segment.NextIndex));
+
+			MaxError = FMath::Max(MaxError, Distance(EvalBaked(*Track, Key), Exact));
+		}
+		return MaxError;
+	}
+
+	// -- Mutation --
+	void SetValue(int32 Index, const ValueType& InValue) const
+	{
+		static_assert(!TIsConst<T>::Value, "Can't modify a const curve view");
+		ClearBaked();
+		if (Curve)
+		{
+			Curve->Points[Index].OutVal = InValue;
+		}
+		else
+		{
+			Track->Values[Index] = InValue;
+		}
+	}
+
+	// Insert(), Duplicate() and RemoveAt() only move values. Keys are implicit from the point index, so the input keys
+	// of later points in an FInterpCurve are left as they are until RenumberKeys() is called.
+	void Insert(int32 Index, const ValueType& InValue) const
+	{
+		static_assert(!TIsConst<T>::Value, "Can't modify a const curve view");
+		ClearBaked();
+		if (Curve)
+		{
+			Curve->Points.Insert(FInterpCurvePoint<ValueType>(static_cast<float>(Index), InValue), Index);
+		}
+		else
+		{
+			Track->Values.Insert(InValue, Index);
+			if (Track->Tangents.Num() > 0)
+			{
+				Track->Tangents.Insert(ValueType(ForceInit), Index);
+			}
+		}
+	}
+
+	void Duplicate(int32 Index) const
+	{
+		static_assert(!TIsConst<T>::Value, "Can't modify a const curve view");
+		ClearBaked();
+		if (Curve)
+		{
+			auto& Points = Curve->Points;
+			Points.Insert({ Points[Index] }, Index);
+		}
+		else
+		{
+			const ValueType Value = Track->Values[Index];
+			Track->Values.Insert(Value, Index);
+			if (Track->Tangents.Num() > 0)
+			{
+				const ValueType Tangent = Track->Tangents[Index];
+				Track->Tangents.Insert(Tangent, Index);
+			}
+		}
+	}
+
+	void RemoveAt(int32 Index) const
+	{
+		static_assert(!TIsConst<T>::Value, "Can't modify a const curve view");
+		ClearBaked();
+		if (Curve)
+		{
+			Curve->Points.RemoveAt(Index);
+		}
+		else
+		{
+			Track->Values.RemoveAt(Index);
+			if (Track->Tangents.Num() > 0)
+			{
+				Track->Tangents.RemoveAt(Index);
+			}
+		}
+	}
+
+	/** Sets the input key of every point from InFirstIndex onwards to its index. Only FInterpCurves store keys. */
+	void RenumberKeys(int32 InFirstIndex) const
+	{
+		static_assert(!TIsConst<T>::Value, "Can't modify a const curve view");
+		if (Curve)
+		{
+			auto& Points = Curve->Points;
+			for (int32 i = FMath::Max(InFirstIndex, 0); i < Points.Num(); i++)
+			{
+				Points[i].InVal = static_cast<float>(i);
+			}
+		}
+	}
+
+	void Reset(int32 InSlack) const
+	{
+		static_assert(!TIsConst<T>::Value, "Can't modify a const curve view");
+		ClearBaked();
+		if (Curve)
+		{
+			Curve->Points.Reset(InSlack);
+		}
+		else
+		{
+			Track->Values.Reset(InSlack);
+			Track->Tangents.Reset();
+		}
+	}
+
+	/** Resizes the curve to InNumPoints, filling new points with InDefault. */
+	void SetNum(int32 InNumPoints, const ValueType& InDefault) const
+	{
+		static_assert(!TIsConst<T>::Value, "Can't modify a const curve view");
+		ClearBaked();
+		if (Curve)
+		{
+			auto& Points = Curve->Points;
+			if (Points.Num() > InNumPoints)
+			{
+				Points.RemoveAt(InNumPoints, Points.Num() - InNumPoints);
+			}
+
+			Points.Reserve(InNumPoints);
+			while (Points.Num() < InNumPoints)
+			{
+				Points.Emplace(static_cast<float>(Points.Num()), InDefault);
+			}
+		}
+		else
+		{
+			auto& Values = Track->Values;
+			if (Values.Num() > InNumPoints)
+			{
+				Values.RemoveAt(InNumPoints, Values.Num() - InNumPoints);
+			}
+
+			Values.Reserve(InNumPoints);
+			while (Values.Num() < InNumPoints)
+			{
+				Values.Add(InDefault);
+			}
+
+			if (Track->Tangents.Num() > 0)
+			{
+				Track->Tangents.SetNumZeroed(InNumPoints);
+			}
+		}
+	}
+
+	/** Same as FInterpCurve::AutoSetTangents(). Loop state must already be set. */
+	void AutoSetTangents(float Tension, bool bStationaryEndpoints) const
+	{
+		AutoSetTangents(Tension, bStationaryEndpoints, 0, Num());
+	}
+
+	/**
+	 * Same as AutoSetTangents(), but only updates the tangents of the points in [InBegin, InEnd).
+	 * Tangents only depend on the neighbouring points, so the caller is responsible for including them in the range.
+	 */
+	void AutoSetTangents(float Tension, bool bStationaryEndpoints, int32 InBegin, int32 InEnd) const
+	{
+		static_assert(!TIsConst<T>::Value, "Can't modify a const curve view");
+
+		const int32 NumPoints = Num();
+		InBegin = FMath::Max(InBegin, 0);
+		InEnd = FMath::Min(InEnd, NumPoints);
+
+		if (Curve)
+		{
+			if (InBegin == 0 && InEnd == NumPoints)
+			{
+				Curve->AutoSetTangents(Tension, bStationaryEndpoints);
+				return;
+			}
+
+			for (int32 PointIndex = InBegin; PointIndex < InEnd; PointIndex++)
+			{
+				SetCurvePointTangent(PointIndex, Tension, bStationaryEndpoints);
+			}
+			return;
+		}
+
+		ClearBaked();
+
+		if (Track->InterpMode != CIM_CurveAuto && Track->InterpMode != CIM_CurveAutoClamped)
+		{
+			// Linear and constant segments never read tangents, so don't spend memory on them.
+			Track->Tangents.Empty();
+			return;
+		}
+
+		const TArray<ValueType>& Values = Track->Values;
+		TArray<ValueType>& Tangents = Track->Tangents;
+
+		// Tangents that were never computed can't be partially updated.
+		if (Tangents.Num() != NumPoints)
+		{
+			Tangents.SetNumUninitialized(NumPoints);
+			InBegin = 0;
+			InEnd = NumPoints;
+		}
+
+		const bool bLooped = Storage->bIsLooped;
+		const float LoopOffset = Storage->LoopKeyOffset;
+		const bool bWantClamping = (Track->InterpMode == CIM_CurveAutoClamped);
+		const int32 LastPoint = NumPoints - 1;
+
+		for (int32 PointIndex = InBegin; PointIndex < InEnd; PointIndex++)
+		{
+			if (bStationaryEndpoints && (PointIndex == 0 || (PointIndex == LastPoint && !bLooped)))
+			{
+				Tangents[PointIndex] = ValueType(ForceInit);
+				continue;
+			}
+
+			const int32 PrevIndex = (PointIndex == 0) ? (bLooped ? LastPoint : 0) : (PointIndex - 1);
+			const int32 NextIndex = (PointIndex == LastPoint) ? (bLooped ? 0 : LastPoint) : (PointIndex + 1);
+
+			const float ThisTime = static_cast<float>(PointIndex);
+			const float PrevTime = (bLooped && PointIndex == 0) ? (ThisTime - LoopOffset) : static_cast<float>(PrevIndex);
+			const float NextTime = (bLooped && PointIndex == LastPoint) ? (ThisTime + LoopOffset) : static_cast<float>(NextIndex);
+
+			ComputeCurveTangent(PrevTime, Values[PrevIndex], ThisTime, Values[PointIndex], NextTime, Values[NextIndex], Tension, bWantClamping, Tangents[PointIndex]);
+		}
+	}
+
+private:
+	/** The body of the loop in FInterpCurve::AutoSetTangents(), for a single point. */
+	void SetCurvePointTangent(int32 PointIndex, float Tension, bool bStationaryEndpoints) const
+	{
+		auto& Points = Curve->Points;
+		const bool bLooped = Curve->bIsLooped;
+		const int32 LastPoint = Points.Num() - 1;
+
+		const int32 PrevIndex = (PointIndex == 0) ? (bLooped ? LastPoint : 0) : (PointIndex - 1);
+		const int32 NextIndex = (PointIndex == LastPoint) ? (bLooped ? 0 : LastPoint) : (PointIndex + 1);
+
+		auto& ThisPoint = Points[PointIndex];
+		const auto& PrevPoint = Points[PrevIndex];
+		const auto& NextPoint = Points[NextIndex];
+
+		if (ThisPoint.InterpMode == CIM_CurveAuto || ThisPoint.InterpMode == CIM_CurveAutoClamped)
+		{
+			if (bStationaryEndpoints && (PointIndex == 0 || (PointIndex == LastPoint && !bLooped)))
+			{
+				ThisPoint.ArriveTangent = ValueType(ForceInit);
+				ThisPoint.LeaveTangent = ValueType(ForceInit);
+			}
+			else if (PrevPoint.IsCurveKey())
+			{
+				const bool bWantClamping = (ThisPoint.InterpMode == CIM_CurveAutoClamped);
+				// Same as the packed tracks, the times come from the point indices rather than the stored keys.
+				const float ThisTime = static_cast<float>(PointIndex);
+				const float PrevTime = (bLooped && PointIndex == 0) ? (ThisTime - Curve->LoopKeyOffset) : static_cast<float>(PrevIndex);
+				const float NextTime = (bLooped && PointIndex == LastPoint) ? (ThisTime + Curve->LoopKeyOffset) : static_cast<float>(NextIndex);
+
+				ValueType Tangent;
+				ComputeCurveTangent(PrevTime, PrevPoint.OutVal, ThisTime, ThisPoint.OutVal, NextTime, NextPoint.OutVal, Tension, bWantClamping, Tangent);
+
+				ThisPoint.ArriveTangent = Tangent;
+				ThisPoint.LeaveTangent = Tangent;
+			}
+			else
+			{
+				ThisPoint.ArriveTangent = PrevPoint.ArriveTangent;
+				ThisPoint.LeaveTangent = PrevPoint.LeaveTangent;
+			}
+		}
+		else if (ThisPoint.InterpMode == CIM_Linear)
+		{
+			const ValueType Tangent = NextPoint.OutVal - ThisPoint.OutVal;
+			ThisPoint.ArriveTangent = Tangent;
+			ThisPoint.LeaveTangent = Tangent;
+		}
+		else if (ThisPoint.InterpMode == CIM_Constant)
+		{
+			ThisPoint.ArriveTangent = ValueType(ForceInit);
+			ThisPoint.LeaveTangent = ValueType(ForceInit);
+		}
+	}
+
+	void ClearBaked() const
+	{
+		if (Track)
+		{
+			Track->Baked.Empty();
+			Track->BakedInvStep = 0.0f;
+		}
+	}
+
+	CurveType* Curve = nullptr;
+	TrackType* Track = nullptr;
+	StorageType* Storage = nullptr;
+};
@@ -3,6 +3,7 @@
 #include "MetaSplineMetadata.h"
 #include "MetaSplineComponent.h"
 #include "MetaSplineTemplateHelpers.h"
+#include "MetaSplinePointChange.h"
 #include "MetaSpline.h"
 
 #include <PropertyEditorModule.h>
@@ -49,59 +50,77 @@ void FMetaSplineMetadataDetails::Update(USplineComponent* InSplineComponent, con
 			GetMetadata()->UpdateMetadataClass(MetaSpline->MetadataClass);
 			MetaClass = MetaSpline->MetadataClass;
 			MetaClassInstances.Empty();
-		}
+			bShowingInstances = false;
 
-		// Make sure the number of instances match the number of selected points
-		while (MetaClassInstances.Num() < InSelectedKeys.Num())
-		{
-			MetaClassInstances.Emplace(MetaClass ? NewObject<UObject>(GetTransientPackage(), *MetaClass) : nullptr);
+			if (MetaClass)
+			{
+				MetaClassInstances.Emplace(NewObject<UObject>(GetTransientPackage(), *MetaClass));
+				MetaClassInstances.Emplace(NewObject<UObject>(GetTransientPackage(), *MetaClass));
+			}
 		}
 
-		if (MetaClassInstances.Num() > InSelectedKeys.Num())
-		{
-			MetaClassInstances.RemoveAtSwap(InSelectedKeys.Num(), MetaClassInstances.Num() - InSelectedKeys.Num());
-		}
+		UpdateShownInstances();
+	}
 
-		DetailsView->SetObjects(MetaClassInstances);
+	if (MetaClassInstances.Num() == 0 || InSelectedKeys.Num() == 0)
+	{
+		return;
 	}
 
 	if (UMetaSplineMetadata* Metadata = GetMetadata())
 	{
-		const auto& Positions = SplineComp->SplineCurves.Position;
-		const bool bIsLooped = Positions.bIsLooped;
-		const float LoopKey = Positions.LoopKeyOffset + Positions.Points.Last().InVal;
-
-		Metadata->TransformCurves([this, &InSelectedKeys, bIsLooped, LoopKey](FName Key, auto& Curve)
+		const FMetaSplineStructLayout& Layout = FMetaSplineStructLayout::Get(MetaClass);
+		AsConst(*Metadata).TransformCurves([this, &InSelectedKeys, &Layout](FName Key, const auto& Curve)
 		{
-			const auto& Points = Curve.Points;
+			using TUnderlyingType = typename TDecay<decltype(Curve)>::Type::ValueType;
 
-			TArray<UObject*>::TIterator It = MetaClassInstances.CreateIterator();
-			const FProperty* Property = MetaClass->FindPropertyByName(Key);
+			const FMetaSplinePropertyLayout* Property = Layout.Find(Key);
+			if (!Property || Property->Type != TMetaSplinePropertyType<TUnderlyingType>::Value)
+			{
+				return;
+			}
+
+			// The first instance gets the value of the first point, and the second one any value that differs from it.
+			TOptional<TUnderlyingType> FirstValue;
+			TOptional<TUnderlyingType> OtherValue;
 			for (int32 Index : InSelectedKeys)
 			{
-				if (Index >= Points.Num())
+				if (Index >= Curve.Num())
 				{
 					continue;
 				}
-				using TUnderlyingType = TCurveUnderlyingType<decltype(Curve)>::Type;
-				*Property->ContainerPtrToValuePtr<TUnderlyingType>(*It) = Points[Index].OutVal;
-				++It;
-			}
 
-			if (bIsLooped)
-			{
-				Curve.SetLoopKey(LoopKey);
+				const TUnderlyingType Value = Curve.GetValue(Index);
+				if (!FirstValue.IsSet())
+				{
+					FirstValue = Value;
+				}
+				else if (Value != FirstValue.GetValue())
+				{
+					OtherValue = Value;
+					break;
+				}
 			}
-			else
+
+			if (FirstValue.IsSet())
 			{
-				Curve.ClearLoopKey();
+				Property->GetValue<TUnderlyingType>(MetaClassInstances[0]) = FirstValue.GetValue();
+				Property->GetValue<TUnderlyingType>(MetaClassInstances[1]) = OtherValue.Get(FirstValue.GetValue());
 			}
-
-			Curve.AutoSetTangents(0.0f, SplineComp->bStationaryEndpoints);
 		});
 	}
 }
 
+void FMetaSplineMetadataDetails::UpdateShownInstances()
+{
+	const bool bShouldShowInstances = MetaClassInstances.Num() > 0 && SelectedKeys.Num() > 0;
+	if (DetailsView.IsValid() && bShouldShowInstances != bShowingInstances)
+	{
+		DetailsView->SetObjects(bShouldShowInstances ? MetaClassInstances : TArray<UObject*>());
+		bShowingInstances = bShouldShowInstances;
+	}
+}
+
 void FMetaSplineMetadataDetails::GenerateChildContent(IDetailGroup& InGroup)
 {
 	FDetailsViewArgs Args;
@@ -120,6 +139,11 @@ void FMetaSplineMetadataDetails::GenerateChildContent(IDetailGroup& InGroup)
 	FPropertyEditorModule& PropertyEditorModule = FModuleManager::GetModuleChecked<FPropertyEditorModule>("PropertyEditor");
 	DetailsView = PropertyEditorModule.CreateDetailView(Args);
 	DetailsView->OnFinishedChangingProperties().AddSP(this, &FMetaSplineMetadataDetails::OnFinishedChangingProperties);
+
+	// The new view starts out empty, so give it the instances again.
+	bShowingInstances = false;
+	UpdateShownInstances();
+
 	const auto VisibilityAttr = TAttribute<EVisibility>::Create([this]() { return MetaClass ? EVisibility::Visible : EVisibility::Collapsed; });
 
 	InGroup.HeaderRow()
@@ -168,47 +192,72 @@ class UMetaSplineMetadata* FMetaSplineMetadataDetails::GetMetadata() const
 	return SplineComp.IsValid() ? Cast<UMetaSplineMetadata>(SplineComp->GetSplinePointsMetadata()) : nullptr;
 }
 
-// Wrapper struct that can be passed to FMetaSplineTemplateHelpers::ExecuteOnProperty, that updates the FInterpCurve for
-// a modified property.
+// Wrapper struct that can be passed to FMetaSplineTemplateHelpers::ExecuteOnProperty, that writes the edited value of a property
+// to every selected point. Returns true if any point changed.
 template<typename T>
 struct FUpdateMetadata
 {
-	static void Execute(FMetaSplineMetadataDetails& InOutDetails, UMetaSplineMetadata& InOutMetadata, const FProperty* InProperty)
+	static bool Execute(FMetaSplineMetadataDetails& InOutDetails, UMetaSplineMetadata& InOutMetadata, const FProperty* InMemberProperty, const FProperty* InEditedProperty)
 	{
-		auto* Curve = InOutMetadata.FindCurve<T>(InProperty->GetFName());
-		if (!Curve)
+		// Look for the points that actually change first, so that shared storage isn't copied and tangents aren't recomputed
+		// for an edit that doesn't change anything.
+		const auto CurrentCurve = AsConst(InOutMetadata).FindCurve<T>(InMemberProperty->GetFName());
+		if (!CurrentCurve)
 		{
 			// #TODO: Make sure this doesn't happen...
 			UE_LOG(LogMetaSpline, Error, TEXT("Couldn't find curve to modify. Please refresh the metadata class"));
-			return;
+			return false;
 		}
 
-		if (!InOutDetails.SplineComp.IsValid())
-		{
-			return;
-		}
+		const T& EditedValue = *InMemberProperty->ContainerPtrToValuePtr<T>((*InOutDetails.GetMetaClassInstances())[0]);
 
-		USplineComponent* Spline = InOutDetails.SplineComp.Get();
-		const TSet<int32>& SelectedKeys = InOutDetails.SelectedKeys;
+		// The instances only hold the value of one of the points. If a single component of a struct was edited, such as the Y of
+		// a vector, only that component is written, and every point keeps the rest of its own value.
+		const FStructProperty* MemberStruct = CastField<FStructProperty>(InMemberProperty);
+		const bool bIsComponentEdit = MemberStruct && InEditedProperty && InEditedProperty != InMemberProperty && InEditedProperty->GetOwnerStruct() == MemberStruct->Struct;
 
-		TArray<UObject*>::TConstIterator It = InOutDetails.GetMetaClassInstances()->CreateConstIterator();
-		for (int32 Index : SelectedKeys)
+		TArray<int32> ChangedPoints;
+		FMetaSplinePointValues Before;
+		FMetaSplinePointValues After;
+		for (int32 Index : InOutDetails.SelectedKeys)
 		{
-			Curve->Points[Index].OutVal = *InProperty->ContainerPtrToValuePtr<T>(*It);
-			++It;
+			if (Index >= CurrentCurve.Num())
+			{
+				continue;
+			}
+
+			const T CurrentValue = CurrentCurve.GetValue(Index);
+			T NewValue = EditedValue;
+			if (bIsComponentEdit)
+			{
+				NewValue = CurrentValue;
+				InEditedProperty->CopyCompleteValue(InEditedProperty->ContainerPtrToValuePtr<void>(&NewValue), InEditedProperty->ContainerPtrToValuePtr<void>(&EditedValue));
+			}
+
+			if (NewValue != CurrentValue)
+			{
+				ChangedPoints.Add(Index);
+				Before.Get<T>().Add(CurrentValue);
+				After.Get<T>().Add(NewValue);
+			}
 		}
 
-		Spline->UpdateSpline();
-		Spline->bSplineHasBeenEdited = true;
+		if (ChangedPoints.Num() == 0)
+		{
+			return false;
+		}
 
-		InOutDetails.Update(Spline, SelectedKeys);
+		// Only the written values are recorded for undo, the same way as the bulk writers on the component.
+		InOutMetadata.SetPropertyValues(InMemberProperty->GetFName(), ChangedPoints, After);
+		InOutMetadata.RecordPropertyChange(InMemberProperty->GetFName(), MoveTemp(ChangedPoints), MoveTemp(Before), MoveTemp(After));
+		return true;
 	}
 };
 
 void FMetaSplineMetadataDetails::OnFinishedChangingProperties(const FPropertyChangedEvent& InProperty)
 {
 	auto* Metadata = GetMetadata();
-	if (!Metadata)
+	if (!Metadata || !SplineComp.IsValid() || MetaClassInstances.Num() == 0)
 		return;
 	
 	Metadata->SetFlags(RF_Transactional);
@@ -216,12 +265,24 @@ void FMetaSplineMetadataDetails::OnFinishedChangingProperties(const FPropertyCha
 	FProperty* ModifiedProperty = InProperty.MemberProperty;
 	FScopedTransaction Transaction(FText::Format(LOCTEXT("ModifiedProperty", "MetaSpline: {0} value changed"), ModifiedProperty->GetDisplayNameText()));
 
-	Metadata->Modify();
-	FMetaSplineTemplateHelpers::ExecuteOnProperty<FUpdateMetadata>(ModifiedProperty, *this, *Metadata, ModifiedProperty);
+	if (!FMetaSplineTemplateHelpers::ExecuteOnProperty<FUpdateMetadata>(ModifiedProperty, *this, *Metadata, ModifiedProperty, InProperty.Property))
+	{
+		Transaction.Cancel();
+		return;
+	}
+
+	USplineComponent* Spline = SplineComp.Get();
+	Spline->UpdateSpline();
+	Spline->bSplineHasBeenEdited = true;
+
 	Metadata->PostEditChange();
 
 	static FProperty* MetadataProperty = FindFProperty<FProperty>(UMetaSplineComponent::StaticClass(), GET_MEMBER_NAME_CHECKED(UMetaSplineComponent, Metadata));
-	FComponentVisualizer::NotifyPropertyModified(SplineComp.Get(), MetadataProperty);
+	FComponentVisualizer::NotifyPropertyModified(Spline, MetadataProperty);
+
+	// After editing a single component of a struct the points may still differ in the others, so refresh both instances.
+	const TSet<int32> Keys = SelectedKeys;
+	Update(Spline, Keys);
 }
 
-#undef LOCTEXT_NAMESPACE
\ No newline at end of file
+#undef LOCTEXT_NAMESPACE
@@ -41,13 +41,19 @@ private:
 	class UMetaSplineMetadata* GetMetadata() const;
 
 	void OnFinishedChangingProperties(const FPropertyChangedEvent& InProperty);
+
+	/** Shows the instances in the details view while points are selected. */
+	void UpdateShownInstances();
 private:
 
 	TSharedPtr<class IDetailsView> DetailsView = nullptr;
 
 	TSubclassOf<UObject> MetaClass;
 
-	// We use an array of instances of the meta class to allow the details view widget to do as much work for us as possible.
-	// In this case, if we edit multiple points, it will automatically handle points with different settings, and display the appropriate value.
+	// Two pooled instances of the meta class stand in for all selected points, regardless of how many there are. The details view
+	// only shows "Multiple Values" when the objects it edits disagree, which a single instance can't do, so the second one holds a
+	// different value than the first wherever the selected points disagree. Edits are written back to every selected point, and
+	// only the edited component of a struct is written, so each point keeps the rest of its own value.
 	TArray<UObject*> MetaClassInstances;
+	bool bShowingInstances = false;
 };